@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Writes a synthetic TypeScript corpus that exercises the constructs the converter spends its time on.
+ *
+ * The same size and seed always give the same text, on every platform, so that results can be compared between runs
+ * and machines. The corpus is built from independent groups of declarations, each of which has, in order:
+ *
+ * - an enum and a large string literal union
+ * - a chain of interfaces, each extending the last
+ * - an interface with inline objects nested several levels deep
+ * - a chain of Partial, Omit and Pick aliases over the end of the interface chain
+ *
+ * With comments, every declaration and member is documented as in a hand-written or bundled declaration file: mostly
+ * JSDoc blocks, with some line comments.
+ */
+class corpus_generator
+{
+public:
+    explicit corpus_generator(std::uint64_t seed = 1, bool comments = false) : state(seed), comments(comments) {}
+
+    /**
+     * @brief Appends declarations to 'out' until it holds at least 'size' bytes. Calling it again carries on from
+     * where it stopped, so a corpus can be grown a step at a time.
+     */
+    void generate(std::string& out, std::size_t size)
+    {
+        while (out.size() < size) append_declaration(out);
+    }
+
+private:
+    // splitmix64; unlike the standard distributions, it gives the same sequence with every standard library
+    std::uint64_t next()
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::size_t below(std::size_t bound) { return static_cast<std::size_t>(next() % bound); }
+
+    const char* fundamental()
+    {
+        static const char* const types[] = { "string", "number", "boolean", "string[]", "number[]", "unknown" };
+        return types[below(sizeof(types) / sizeof(types[0]))];
+    }
+
+    void append_comment(std::string& out, const std::string& indent)
+    {
+        static const char* const words[] = { "the", "value", "of", "this", "field", "is", "used", "when", "a",
+            "request", "returns", "an", "optional", "identifier", "for", "each", "item", "in", "list", "and",
+            "should", "not", "be", "changed", "after", "creation", "see", "also", "default", "config" };
+        const auto append_words = [&](std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) (out += ' ') += words[below(sizeof(words) / sizeof(words[0]))];
+        };
+
+        if (below(4) == 0)
+        {
+            out += indent + "//";
+            append_words(4 + below(8));
+            out += "\n";
+            return;
+        }
+
+        out += indent + "/**\n";
+        for (std::size_t line = 1 + below(3); line > 0; --line)
+        {
+            out += indent + " *";
+            append_words(6 + below(10));
+            out += "\n";
+        }
+        if (below(2) == 0) out += indent + " *\n" + indent + " * @default undefined\n";
+        out += indent + " */\n";
+    }
+
+    void append_members(std::string& out, const std::string& indent, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (comments) append_comment(out, indent);
+            out += indent + "field" + std::to_string(i) + (below(4) == 0 ? "?: " : ": ") + fundamental() + ";\n";
+        }
+    }
+
+    void append_object(std::string& out, const std::string& indent, std::size_t depth)
+    {
+        out += "{\n";
+        append_members(out, indent + "\t", 2 + below(3));
+        if (depth > 0)
+        {
+            out += indent + "\tchild: ";
+            append_object(out, indent + "\t", depth - 1);
+            out += ";\n";
+            out += indent + "\tchildren: Array<";
+            append_object(out, indent + "\t", depth - 1);
+            out += ">;\n";
+        }
+        out += indent + "}";
+    }
+
+    /**
+     * @brief Appends the next declaration of the current group, or starts a new group.
+     */
+    void append_declaration(std::string& out)
+    {
+        const std::string g = std::to_string(group);
+        if (comments) append_comment(out, "");
+        if (part == 0)
+        {
+            depth = 4 + below(8);
+            out += "export enum Kind" + g + " {\n";
+            const std::size_t enum_count = 4 + below(8);
+            for (std::size_t i = 0; i < enum_count; ++i) out += "\tValue" + std::to_string(i) + " = " + std::to_string(i) + ",\n";
+            out += "}\n\n";
+        }
+        else if (part == 1)
+        {
+            out += "export type Status" + g + " =";
+            const std::size_t union_count = 16 + below(48);
+            for (std::size_t i = 0; i < union_count; ++i)
+            {
+                out += (i ? "\n\t| \"status_" : " \"status_") + std::to_string(next() % 100000) + "\"";
+            }
+            out += ";\n\n";
+        }
+        else if (part < 2 + depth)
+        {
+            // Deep extends chain
+            const std::string level = std::to_string(part - 2);
+            out += "export interface Level" + g + "_" + level;
+            if (part > 2) out += " extends Level" + g + "_" + std::to_string(part - 3);
+            out += " {\n";
+            out += "\tid" + level + ": number;\n";
+            out += "\tkind" + level + ": Kind" + g + ";\n";
+            out += "\tstatus" + level + "?: Status" + g + ";\n";
+            out += "\tlink" + level + ": Level" + g + "_0 | undefined;\n";
+            out += "}\n\n";
+        }
+        else if (part == 2 + depth)
+        {
+            out += "export interface Nested" + g + " ";
+            append_object(out, "", 2 + below(2));
+            out += "\n\n";
+        }
+        else
+        {
+            // Utility type chains over the end of the extends chain
+            const std::string leaf = "Level" + g + "_" + std::to_string(depth - 1);
+            out += "export type Patch" + g + " = Partial<" + leaf + ">;\n";
+            out += "export type Trimmed" + g + " = Omit<Patch" + g + ", \"id0\" | \"kind0\">;\n";
+            out += "export type Picked" + g + " = Pick<" + leaf + ", \"id1\" | \"status1\">;\n";
+            out += "export type Combined" + g + " = Trimmed" + g + " & {\n\tnested: Nested" + g +
+                ";\n\ttags: [string, number, boolean];\n};\n\n";
+            ++group;
+            part = 0;
+            return;
+        }
+        ++part;
+    }
+
+    std::uint64_t state;
+    bool comments;
+    std::size_t group = 0;
+    std::size_t part = 0;  // The next declaration of the group to write
+    std::size_t depth = 0; // The length of the group's extends chain
+};
+
+/**
+ * @brief Parses a byte count with an optional K, M or G suffix (powers of 1024), e.g. "64M".
+ *
+ * @return False if the text isn't a count.
+ */
+inline bool parse_size(const std::string& text, std::size_t& size)
+{
+    std::size_t digits = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') ++digits;
+    if (digits == 0 || digits + 1 < text.size()) return false;
+
+    size = static_cast<std::size_t>(std::stoull(text.substr(0, digits)));
+    if (digits == text.size()) return true;
+    switch (text[digits])
+    {
+    case 'K': case 'k': size <<= 10; return true;
+    case 'M': case 'm': size <<= 20; return true;
+    case 'G': case 'g': size <<= 30; return true;
+    default: return false;
+    }
+}
@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "corpus.h"
+
+int main(int argc, char** argv)
+{
+    const bool comments = (argc > 1) && (std::string(argv[1]) == "--comments");
+    const int first = comments ? 2 : 1;
+
+    std::size_t size = 0;
+    if (argc < first + 2 || argc > first + 3 || !parse_size(argv[first], size))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--comments] <size[K|M|G]> <output_file | -> [seed]\n"
+                  << "   Writes a deterministic synthetic TypeScript corpus of at least the given size. --comments\n"
+                  << "   documents every declaration and member, as bundled declaration files do.\n";
+        return 1;
+    }
+    const std::uint64_t seed = (argc == first + 3) ? std::strtoull(argv[first + 2], nullptr, 10) : 1;
+
+    std::string text;
+    text.reserve(size + 64 * 1024);
+    corpus_generator(seed, comments).generate(text, size);
+
+    const std::string output = argv[first + 1];
+    if (output == "-")
+    {
+        std::cout << text;
+        return std::cout ? 0 : 1;
+    }
+
+    std::ofstream out(output, std::ios::binary);
+    out << text;
+    if (!out)
+    {
+        std::cerr << "ERROR: Failed to write '" << output << "'\n";
+        return 1;
+    }
+    return 0;
+}
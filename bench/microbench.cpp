@@ -0,0 +1,169 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "lexer.h"
+#include "parser.h"
+#include "emit/codegen_cpp.h"
+#include "emit/codegen_proto.h"
+
+/**
+ * @brief Discards everything written to it, so that emitter timings don't include building the output in memory.
+ */
+class null_streambuf : public std::streambuf
+{
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+};
+
+struct phase_result
+{
+    const char* phase;
+    std::size_t size;
+    double seconds_per_run;
+};
+
+/**
+ * @brief Runs 'body' repeatedly for at least 'min_seconds' (and at least once), and returns the fastest run.
+ */
+static double time_best(double min_seconds, const std::function<void()>& body)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 0;
+    double total = 0;
+    for (int runs = 0; runs == 0 || total < min_seconds; ++runs)
+    {
+        const auto start = clock::now();
+        body();
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best = (runs == 0) ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+static void print_usage(const char* exe_name)
+{
+    std::cerr << "Usage: " << exe_name << " [--min-size SIZE] [--max-size SIZE] [--min-time SECONDS] [--threads N]\n"
+              << "           [--csv FILE]\n"
+              << "   Times the lexer, parser and emitters on synthetic corpora from --min-size (default 1K) to\n"
+              << "   --max-size (default 64M), quadrupling each step. Sizes take K, M or G suffixes. --threads sets\n"
+              << "   the threads the C++ emitter uses (default 1; 0 uses every hardware thread).\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t min_size = 1 << 10;
+    std::size_t max_size = 64 << 20;
+    double min_time = 0.5;
+    std::size_t threads = 1;
+    std::string csv_file;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (arg == "--min-size" && has_value && parse_size(argv[i + 1], min_size)) {
+            ++i;
+        } else if (arg == "--max-size" && has_value && parse_size(argv[i + 1], max_size)) {
+            ++i;
+        } else if (arg == "--min-time" && has_value) {
+            min_time = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--threads" && has_value) {
+            threads = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--csv" && has_value) {
+            csv_file = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (min_size == 0 || min_size > max_size)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    null_streambuf discard_buffer;
+    std::ostream discard(&discard_buffer);
+    const codegen_config config;
+
+    // Each size extends the previous corpus, so smaller corpora are prefixes of larger ones
+    corpus_generator generator;
+    std::string text;
+    std::vector<phase_result> results;
+
+    std::cout << std::setw(10) << "size" << std::setw(12) << "phase" << std::setw(14) << "ms/run" << std::setw(12)
+              << "MB/s" << std::setw(12) << "scaling" << "\n";
+    for (std::size_t size = min_size; size <= max_size; size *= 4)
+    {
+        generator.generate(text, size);
+        const std::string_view source = text;
+
+        std::size_t tokens = 0;
+        const double lex = time_best(min_time, [&] {
+            ast::file scratch;
+            std::ostringstream ignored;
+            tokens = 0;
+            for (lexer lex(source, &scratch, ignored); lex; lex.advance()) ++tokens;
+        });
+
+        std::unique_ptr<ast::file> file;
+        const double parse = time_best(min_time, [&] {
+            std::ostringstream diagnostics;
+            file = parse_file(source, diagnostics);
+        });
+        if (!file)
+        {
+            std::cerr << "ERROR: The generated corpus of " << text.size() << " bytes failed to parse\n";
+            return 1;
+        }
+
+        const double cpp = time_best(min_time, [&] { generate_cpp(discard, file.get(), config, threads); });
+        const double proto = time_best(min_time, [&] { generate_proto(discard, file.get(), config); });
+
+        results.push_back({ "lex", text.size(), lex });
+        results.push_back({ "parse", text.size(), parse });
+        results.push_back({ "emit-cpp", text.size(), cpp });
+        results.push_back({ "emit-proto", text.size(), proto });
+
+        // Scaling compares throughput with the smallest corpus; 1.00 means time grows linearly with size
+        for (std::size_t i = results.size() - 4; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            const auto& first = results[i % 4];
+            const double throughput = r.size / r.seconds_per_run / (1024.0 * 1024.0);
+            const double first_throughput = first.size / first.seconds_per_run / (1024.0 * 1024.0);
+            std::cout << std::setw(10) << r.size << std::setw(12) << r.phase << std::setw(14) << std::fixed
+                      << std::setprecision(3) << r.seconds_per_run * 1000 << std::setw(12) << std::setprecision(1)
+                      << throughput << std::setw(12) << std::setprecision(2) << throughput / first_throughput << "\n";
+        }
+        std::cout << std::setw(10) << "" << "  " << tokens << " tokens, " << file->node_count() << " nodes\n"
+                  << std::flush;
+    }
+
+    if (!csv_file.empty())
+    {
+        std::ofstream csv(csv_file);
+        csv << "phase,bytes,seconds,mb_per_s\n";
+        for (const auto& r : results)
+        {
+            csv << r.phase << ',' << r.size << ',' << r.seconds_per_run << ','
+                << r.size / r.seconds_per_run / (1024.0 * 1024.0) << "\n";
+        }
+        if (!csv)
+        {
+            std::cerr << "ERROR: Failed to write '" << csv_file << "'\n";
+            return 1;
+        }
+    }
+    return 0;
+}
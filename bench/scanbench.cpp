@@ -0,0 +1,252 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "lexer.h"
+#include "scan.h"
+
+/**
+ * @brief Runs 'body' repeatedly for at least 'min_seconds' (and at least once), and returns the fastest run.
+ */
+static double time_best(double min_seconds, const std::function<void()>& body)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 0;
+    double total = 0;
+    for (int runs = 0; runs == 0 || total < min_seconds; ++runs)
+    {
+        const auto start = clock::now();
+        body();
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best = (runs == 0) ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+using kernel_function = const char* (*)(const char* pos, const char* end);
+
+struct kernel_info
+{
+    const char* name;
+    kernel_function scan_kernels::*function;
+};
+
+static const kernel_info kernels[] = {
+    { "whitespace", &scan_kernels::skip_whitespace },
+    { "line-comment", &scan_kernels::find_newline },
+    { "block-comment", &scan_kernels::find_comment_end },
+    { "identifier", &scan_kernels::skip_identifier },
+};
+static constexpr std::size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+/**
+ * @brief Where in the text the lexer calls each kernel, so that each can be timed on the runs it really sees.
+ */
+struct call_sites
+{
+    std::vector<std::size_t> offsets[kernel_count];
+    std::size_t bytes[kernel_count] = {}; // The total length of the runs each kernel finds the end of
+};
+
+/**
+ * @brief Walks the text as the lexer does, using the scalar kernels, and records the offset of every kernel call.
+ */
+static call_sites find_call_sites(std::string_view text)
+{
+    const scan_kernels& scalar = scan_kernels_for(scan_level::scalar);
+    const char* const begin = text.data();
+    const char* const end = begin + text.size();
+
+    call_sites sites;
+    const auto call = [&](std::size_t kernel, const char* pos) {
+        sites.offsets[kernel].push_back(static_cast<std::size_t>(pos - begin));
+        const char* stop = (scalar.*kernels[kernel].function)(pos, end);
+        sites.bytes[kernel] += static_cast<std::size_t>(stop - pos);
+        return stop;
+    };
+
+    for (const char* pos = begin; pos != end;)
+    {
+        const char ch = *pos;
+        const char next = (end - pos >= 2) ? pos[1] : '\0';
+        if (is_whitespace(ch)) {
+            // The lexer skips a single whitespace character itself
+            pos = is_whitespace(next) ? call(0, pos + 2) : pos + 1;
+        } else if (ch == '/' && next == '/') {
+            pos = call(1, pos + 2);
+            if (pos != end) ++pos;
+        } else if (ch == '/' && next == '*') {
+            pos = call(2, pos + 2);
+            pos += (pos != end) ? 2 : 0;
+        } else if (is_valid_identifier_start(ch)) {
+            pos = call(3, pos + 1);
+        } else if (ch == '"' || ch == '\'' || ch == '`') {
+            // Strings aren't scanned by any kernel; skip them so their contents aren't taken for identifiers
+            ++pos;
+            while (pos != end && *pos++ != ch) {}
+        } else {
+            ++pos;
+        }
+    }
+    return sites;
+}
+
+struct result
+{
+    std::string corpus;
+    std::string kernel;
+    scan_level level;
+    std::size_t bytes;
+    double seconds_per_run;
+};
+
+static void print_usage(const char* exe_name)
+{
+    std::cerr << "Usage: " << exe_name << " [--size SIZE] [--min-time SECONDS] [--csv FILE]\n"
+              << "   Times each of the lexer's scanning kernels at every level this CPU supports against the scalar\n"
+              << "   kernel, on the runs the lexer scans in a synthetic corpus of SIZE (default 16M) with and without\n"
+              << "   comments, and then the whole lexer at each level.\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t size = 16 << 20;
+    double min_time = 0.5;
+    std::string csv_file;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (arg == "--size" && has_value && parse_size(argv[i + 1], size)) {
+            ++i;
+        } else if (arg == "--min-time" && has_value) {
+            min_time = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--csv" && has_value) {
+            csv_file = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (size == 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<scan_level> levels;
+    for (int level = 0; level <= static_cast<int>(best_scan_level()); ++level)
+    {
+        levels.push_back(static_cast<scan_level>(level));
+    }
+
+    std::vector<result> results;
+    std::cout << "best level: " << scan_level_name(best_scan_level()) << "\n"
+              << std::setw(10) << "corpus" << std::setw(15) << "kernel" << std::setw(8) << "level" << std::setw(10)
+              << "calls" << std::setw(12) << "ms/run" << std::setw(12) << "MB/s" << std::setw(10) << "speedup"
+              << "\n";
+
+    for (const bool comments : { false, true })
+    {
+        const std::string corpus = comments ? "comments" : "plain";
+        std::string text;
+        corpus_generator(1, comments).generate(text, size);
+        const char* const begin = text.data();
+        const char* const end = begin + text.size();
+        const call_sites sites = find_call_sites(text);
+
+        const auto print = [&](const result& r, std::size_t calls, double scalar_seconds) {
+            std::cout << std::setw(10) << r.corpus << std::setw(15) << r.kernel << std::setw(8)
+                      << scan_level_name(r.level) << std::setw(10) << calls << std::setw(12) << std::fixed
+                      << std::setprecision(3) << r.seconds_per_run * 1000 << std::setw(12) << std::setprecision(1)
+                      << r.bytes / r.seconds_per_run / (1024.0 * 1024.0) << std::setw(10) << std::setprecision(2)
+                      << scalar_seconds / r.seconds_per_run << "\n";
+        };
+
+        for (std::size_t k = 0; k < kernel_count; ++k)
+        {
+            const auto& offsets = sites.offsets[k];
+            if (offsets.empty()) continue;
+
+            // Every level must stop where the scalar kernel does; the sum also keeps the calls from being optimised out
+            std::uint64_t scalar_sum = 0;
+            double scalar_seconds = 0;
+            kernel_function previous = nullptr;
+            for (const scan_level level : levels)
+            {
+                // A level may reuse a slower level's kernel where its own vectors don't help
+                const kernel_function function = scan_kernels_for(level).*kernels[k].function;
+                if (function == previous) continue;
+                previous = function;
+
+                std::uint64_t sum = 0;
+                const double seconds = time_best(min_time, [&] {
+                    sum = 0;
+                    for (const std::size_t offset : offsets)
+                    {
+                        sum += static_cast<std::uint64_t>(function(begin + offset, end) - begin);
+                    }
+                });
+                if (level == scan_level::scalar)
+                {
+                    scalar_sum = sum;
+                    scalar_seconds = seconds;
+                }
+                else if (sum != scalar_sum)
+                {
+                    std::cerr << "ERROR: The " << scan_level_name(level) << " " << kernels[k].name
+                              << " kernel disagrees with the scalar one\n";
+                    return 1;
+                }
+
+                results.push_back({ corpus, kernels[k].name, level, sites.bytes[k], seconds });
+                print(results.back(), offsets.size(), scalar_seconds);
+            }
+        }
+
+        // The whole lexer, which also pays for everything between the runs
+        double scalar_seconds = 0;
+        std::size_t tokens = 0;
+        for (const scan_level level : levels)
+        {
+            use_scan_level(level);
+            const double seconds = time_best(min_time, [&] {
+                ast::file scratch;
+                std::ostringstream ignored;
+                tokens = 0;
+                for (lexer lex(text, &scratch, ignored); lex; lex.advance()) ++tokens;
+            });
+            if (level == scan_level::scalar) scalar_seconds = seconds;
+
+            results.push_back({ corpus, "lexer", level, text.size(), seconds });
+            print(results.back(), tokens, scalar_seconds);
+        }
+        use_scan_level(best_scan_level());
+    }
+
+    if (!csv_file.empty())
+    {
+        std::ofstream csv(csv_file);
+        csv << "corpus,kernel,level,bytes,seconds,mb_per_s\n";
+        for (const auto& r : results)
+        {
+            csv << r.corpus << ',' << r.kernel << ',' << scan_level_name(r.level) << ',' << r.bytes << ','
+                << r.seconds_per_run << ',' << r.bytes / r.seconds_per_run / (1024.0 * 1024.0) << "\n";
+        }
+        if (!csv)
+        {
+            std::cerr << "ERROR: Failed to write '" << csv_file << "'\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+# ============================================================================
+# @file    server_latency.sh
+# @brief   Compares the latency of converting a file by starting the
+#          converter each time against asking an already running server.
+#
+# Usage: bench/server_latency.sh <ts-type-conv> <input.ts> [config.toml] [runs]
+# ============================================================================
+
+set -euo pipefail
+
+EXE="$1"
+INPUT="$2"
+CONFIG="${3:-}"
+RUNS="${4:-200}"
+
+WORK_DIR="$(mktemp -d)"
+SOCKET="$WORK_DIR/server.sock"
+trap 'kill "$SERVER_PID" 2>/dev/null || true; rm -rf "$WORK_DIR"' EXIT
+
+# Prints the average microseconds per run of the given command
+time_runs() {
+    local start end
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        "$@" > /dev/null
+    done
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000 / RUNS ))
+}
+
+"$EXE" --serve-socket "$SOCKET" &
+SERVER_PID=$!
+while [ ! -S "$SOCKET" ]; do sleep 0.01; done
+
+echo "Converting $INPUT $RUNS times"
+echo "  cold process: $(time_runs "$EXE" "$INPUT" "$WORK_DIR/cold.out" $CONFIG) us per file"
+echo "  server:       $(time_runs "$EXE" --client "$SOCKET" "$INPUT" "$WORK_DIR/warm.out" $CONFIG) us per file"
+
+# Every request over one connection, as a build tool keeping the server open would send them
+for ((i = 0; i < RUNS; i++)); do
+    echo "\"$INPUT\" \"$WORK_DIR/batch.out\""
+done > "$WORK_DIR/batch.manifest"
+start=$(date +%s%N)
+"$EXE" --client "$SOCKET" --batch "$WORK_DIR/batch.manifest" $CONFIG
+end=$(date +%s%N)
+echo "  connection:   $(( (end - start) / 1000 / RUNS )) us per file"
+
+cmp -s "$WORK_DIR/cold.out" "$WORK_DIR/warm.out" && cmp -s "$WORK_DIR/cold.out" "$WORK_DIR/batch.out" || { echo "ERROR: outputs differ"; exit 1; }
@@ -0,0 +1,233 @@
+#include "ast.h"
+
+namespace ast
+{
+    symbol_id declared_name(const node* n) noexcept
+    {
+        if (!n) return invalid_symbol;
+        switch (n->kind)
+        {
+        case node_kind::interface: return static_cast<const interface*>(n)->name_id;
+        case node_kind::type_alias: return static_cast<const type_alias*>(n)->name_id;
+        case node_kind::enumeration: return static_cast<const enumeration*>(n)->name_id;
+        default: return invalid_symbol;
+        }
+    }
+
+    void collect_references(const node* n, std::vector<symbol_id>& references)
+    {
+        if (!n) return;
+        switch (n->kind)
+        {
+        case node_kind::module:
+            for (auto* child : static_cast<const module*>(n)->children) collect_references(child, references);
+            break;
+        case node_kind::member:
+            collect_references(static_cast<const member*>(n)->type, references);
+            break;
+        case node_kind::object:
+            for (auto* m : static_cast<const object*>(n)->named_members) collect_references(m, references);
+            break;
+        case node_kind::interface: {
+            auto* iface = static_cast<const interface*>(n);
+            for (auto* b : iface->base) collect_references(b, references);
+            collect_references(iface->definition, references);
+            break;
+        }
+        case node_kind::interface_reference:
+            references.push_back(static_cast<const interface_reference*>(n)->name_id);
+            break;
+        case node_kind::array:
+            collect_references(static_cast<const array*>(n)->type, references);
+            break;
+        case node_kind::type_alias:
+            collect_references(static_cast<const type_alias*>(n)->target_type, references);
+            break;
+        case node_kind::union_type:
+            for (auto* t : static_cast<const union_type*>(n)->types) collect_references(t, references);
+            break;
+        case node_kind::intersection_type:
+            for (auto* t : static_cast<const intersection_type*>(n)->types) collect_references(t, references);
+            break;
+        case node_kind::tuple_type:
+            for (auto* t : static_cast<const tuple_type*>(n)->elements) collect_references(t, references);
+            break;
+        case node_kind::generic_type_reference: {
+            auto* gref = static_cast<const generic_type_reference*>(n);
+            references.push_back(gref->name_id);
+            for (auto* arg : gref->arguments) collect_references(arg, references);
+            break;
+        }
+        case node_kind::mapped_type: {
+            auto* mapped = static_cast<const mapped_type*>(n);
+            collect_references(mapped->key_type, references);
+            collect_references(mapped->value_type, references);
+            break;
+        }
+        case node_kind::conditional_type: {
+            auto* cond = static_cast<const conditional_type*>(n);
+            collect_references(cond->condition, references);
+            collect_references(cond->extends_type, references);
+            collect_references(cond->true_type, references);
+            collect_references(cond->false_type, references);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @brief Clones every node of a list, parenting the copies to 'parent'.
+     */
+    template <typename T>
+    static void clone_list(file& target, const list<T*>& from, list<T*>& to, node* parent)
+    {
+        to.reserve(from.size());
+        for (auto* n : from)
+        {
+            auto* copy = static_cast<T*>(clone(target, n));
+            if (copy) copy->parent = parent;
+            to.push_back(copy);
+        }
+    }
+
+    static node* clone_child(file& target, const node* n, node* parent)
+    {
+        auto* copy = clone(target, n);
+        if (copy) copy->parent = parent;
+        return copy;
+    }
+
+    node* clone(file& target, const node* n)
+    {
+        if (!n) return nullptr;
+        switch (n->kind)
+        {
+        case node_kind::file:
+            return nullptr;
+        case node_kind::import_stmt: {
+            auto* result = target.make<import_stmt>();
+            result->module_name = static_cast<const import_stmt*>(n)->module_name;
+            return result;
+        }
+        case node_kind::module: {
+            auto* from = static_cast<const module*>(n);
+            auto* result = target.make<module>();
+            result->is_export = from->is_export;
+            result->name = from->name;
+            clone_list(target, from->children, result->children, result);
+            return result;
+        }
+        case node_kind::member: {
+            auto* from = static_cast<const member*>(n);
+            auto* result = target.make<member>();
+            result->is_optional = from->is_optional;
+            result->name = from->name;
+            result->type = clone_child(target, from->type, result);
+            return result;
+        }
+        case node_kind::object: {
+            auto* from = static_cast<const object*>(n);
+            auto* result = target.make<object>();
+            clone_list(target, from->named_members, result->named_members, result);
+            return result;
+        }
+        case node_kind::interface: {
+            auto* from = static_cast<const interface*>(n);
+            auto* result = target.make<interface>();
+            result->is_export = from->is_export;
+            result->name = from->name;
+            result->name_id = target.symbols.intern(from->name);
+            clone_list(target, from->base, result->base, result);
+            result->definition = static_cast<object*>(clone_child(target, from->definition, result));
+            return result;
+        }
+        case node_kind::interface_reference: {
+            auto* from = static_cast<const interface_reference*>(n);
+            auto* result = target.make<interface_reference>();
+            result->name = from->name;
+            result->name_id = target.symbols.intern(from->name);
+            return result;
+        }
+        case node_kind::fundamental_type_reference:
+            return target.make<fundamental_type_reference>(static_cast<const fundamental_type_reference*>(n)->type);
+        case node_kind::array: {
+            auto* result = target.make<array>();
+            result->type = clone_child(target, static_cast<const array*>(n)->type, result);
+            return result;
+        }
+        case node_kind::enumeration: {
+            auto* from = static_cast<const enumeration*>(n);
+            auto* result = target.make<enumeration>();
+            result->is_export = from->is_export;
+            result->name = from->name;
+            result->name_id = target.symbols.intern(from->name);
+            result->members.assign(from->members.begin(), from->members.end());
+            return result;
+        }
+        case node_kind::type_alias: {
+            auto* from = static_cast<const type_alias*>(n);
+            auto* result = target.make<type_alias>();
+            result->is_export = from->is_export;
+            result->name = from->name;
+            result->name_id = target.symbols.intern(from->name);
+            result->target_type = clone_child(target, from->target_type, result);
+            return result;
+        }
+        case node_kind::union_type: {
+            auto* result = target.make<union_type>();
+            clone_list(target, static_cast<const union_type*>(n)->types, result->types, result);
+            return result;
+        }
+        case node_kind::intersection_type: {
+            auto* result = target.make<intersection_type>();
+            clone_list(target, static_cast<const intersection_type*>(n)->types, result->types, result);
+            return result;
+        }
+        case node_kind::literal_type: {
+            auto* from = static_cast<const literal_type*>(n);
+            auto* result = target.make<literal_type>();
+            result->value = from->value;
+            result->is_string = from->is_string;
+            result->is_number = from->is_number;
+            return result;
+        }
+        case node_kind::tuple_type: {
+            auto* result = target.make<tuple_type>();
+            clone_list(target, static_cast<const tuple_type*>(n)->elements, result->elements, result);
+            return result;
+        }
+        case node_kind::template_literal_type: {
+            auto* result = target.make<template_literal_type>();
+            result->value = static_cast<const template_literal_type*>(n)->value;
+            return result;
+        }
+        case node_kind::generic_type_reference: {
+            auto* from = static_cast<const generic_type_reference*>(n);
+            auto* result = target.make<generic_type_reference>();
+            result->name = from->name;
+            result->name_id = target.symbols.intern(from->name);
+            clone_list(target, from->arguments, result->arguments, result);
+            return result;
+        }
+        case node_kind::mapped_type: {
+            auto* from = static_cast<const mapped_type*>(n);
+            auto* result = target.make<mapped_type>();
+            result->key_type = clone_child(target, from->key_type, result);
+            result->value_type = clone_child(target, from->value_type, result);
+            return result;
+        }
+        case node_kind::conditional_type: {
+            auto* from = static_cast<const conditional_type*>(n);
+            auto* result = target.make<conditional_type>();
+            result->condition = clone_child(target, from->condition, result);
+            result->extends_type = clone_child(target, from->extends_type, result);
+            result->true_type = clone_child(target, from->true_type, result);
+            result->false_type = clone_child(target, from->false_type, result);
+            return result;
+        }
+        }
+        return nullptr;
+    }
+}
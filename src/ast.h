@@ -1,63 +1,168 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <string>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "source_buffer.h"
+#include "symbols.h"
+
 namespace ast
 {
+    // Nodes are allocated from their file's arena and are never destroyed individually, so anything a node owns must
+    // come from that same arena; lists are given its allocator on construction
+    using allocator = std::pmr::polymorphic_allocator<std::byte>;
+
+    template <typename T>
+    using list = std::pmr::vector<T>;
+
+    /**
+     * @brief Identifies the concrete type of a node, so that dispatch is a switch rather than a chain of casts.
+     */
+    enum class node_kind : std::uint8_t
+    {
+        file,
+        import_stmt,
+        module,
+        member,
+        object,
+        interface,
+        interface_reference,
+        fundamental_type_reference,
+        array,
+        enumeration,
+        type_alias,
+        union_type,
+        intersection_type,
+        literal_type,
+        tuple_type,
+        template_literal_type,
+        generic_type_reference,
+        mapped_type,
+        conditional_type,
+    };
+
+    /**
+     * @brief Dense index of a node within its file, in creation order. Usable directly as an index into flat arrays
+     * sized by file::node_count(); the file itself is always node 0.
+     */
+    using node_id = std::uint32_t;
+
     struct node
     {
-        virtual ~node() {}
+        explicit node(node_kind kind) noexcept : kind(kind) {}
 
+        const node_kind kind;
+        node_id id = 0;
         node* parent = nullptr;
     };
 
-    struct file : node
+    template <node_kind Kind>
+    struct basic_node : node
     {
+        static constexpr node_kind static_kind = Kind;
+
+        basic_node() noexcept : node(Kind) {}
+    };
+
+    struct file : basic_node<node_kind::file>
+    {
+        // Backing storage for every node in the tree, released all at once when the file is destroyed
+        std::pmr::monotonic_buffer_resource arena;
+
         bool strict = false;
-        std::vector<node*> children;
+        list<node*> children{ allocator(&arena) };
+
+        // Copies of declarations from imported files that something in this one refers to. They can be looked up like
+        // the file's own declarations, but aren't part of its output.
+        list<node*> imported{ allocator(&arena) };
+
+        // Names and literal values throughout the tree are views into this buffer, when the file owns its source
+        std::unique_ptr<source_buffer> source;
+
+        // Ids for the names of every declaration and type reference in the tree
+        symbol_interner symbols;
+
+        /**
+         * @brief Allocates a node of type T from the arena.
+         *
+         * Node types holding lists take the arena's allocator as their first constructor argument.
+         */
+        template <typename T, typename... Args>
+        T* make(Args&&... args)
+        {
+            void* ptr = arena.allocate(sizeof(T), alignof(T));
+            T* result;
+            if constexpr (std::is_constructible_v<T, allocator, Args...>)
+            {
+                result = new (ptr) T(allocator(&arena), std::forward<Args>(args)...);
+            }
+            else
+            {
+                result = new (ptr) T(std::forward<Args>(args)...);
+            }
+            result->id = next_id++;
+            return result;
+        }
+
+        /**
+         * @brief One more than the highest id of any node in the tree.
+         */
+        node_id node_count() const noexcept { return next_id; }
 
-        // For cleanup
-        std::vector<std::unique_ptr<node>> nodes;
+    private:
+        node_id next_id = 1;
     };
 
-    struct import_stmt : node
+    struct import_stmt : basic_node<node_kind::import_stmt>
     {
-        std::string module_name;
+        std::string_view module_name;
     };
 
-    struct module : node
+    struct module : basic_node<node_kind::module>
     {
+        explicit module(allocator alloc) : children(alloc) {}
+
         bool is_export = false;
-        std::string name;
-        std::vector<node*> children;
+        std::string_view name;
+        list<node*> children;
     };
 
-    struct member : node
+    struct member : basic_node<node_kind::member>
     {
         bool is_optional = false;
-        std::string name;
+        std::string_view name;
         node* type;
     };
 
-    struct object : node
+    struct object : basic_node<node_kind::object>
     {
-        std::vector<member*> named_members;
+        explicit object(allocator alloc) : named_members(alloc) {}
+
+        list<member*> named_members;
         // TODO: unnamed members (i.e. arbitrary key:value pairs)
     };
 
-    struct interface : node
+    struct interface : basic_node<node_kind::interface>
     {
+        explicit interface(allocator alloc) : base(alloc) {}
+
         bool is_export = false;
-        std::vector<node*> base;
-        std::string name;
+        list<node*> base;
+        std::string_view name;
+        symbol_id name_id = invalid_symbol;
         object* definition = nullptr;
     };
 
-    struct interface_reference : node
+    struct interface_reference : basic_node<node_kind::interface_reference>
     {
-        std::string name;
+        std::string_view name;
+        symbol_id name_id = invalid_symbol;
     };
 
     enum class fundamental_type
@@ -70,80 +175,155 @@ namespace ast
         never,
     };
 
-    struct fundamental_type_reference : node
+    struct fundamental_type_reference : basic_node<node_kind::fundamental_type_reference>
     {
         fundamental_type type;
         fundamental_type_reference(fundamental_type type) : type(type) {}
     };
 
-    struct array : node
+    struct array : basic_node<node_kind::array>
     {
         node* type;
     };
 
     struct enum_member {
-        std::string name;
-        std::string value;
+        std::string_view name;
+        std::string_view value;
     };
 
-    struct enumeration : node
+    struct enumeration : basic_node<node_kind::enumeration>
     {
+        explicit enumeration(allocator alloc) : members(alloc) {}
+
         bool is_export = false;
-        std::string name;
-        std::vector<enum_member> members;
+        std::string_view name;
+        symbol_id name_id = invalid_symbol;
+        list<enum_member> members;
     };
 
-    struct type_alias : node
+    struct type_alias : basic_node<node_kind::type_alias>
     {
         bool is_export = false;
-        std::string name;
+        std::string_view name;
+        symbol_id name_id = invalid_symbol;
         node* target_type = nullptr;
     };
 
-    struct union_type : node
+    struct union_type : basic_node<node_kind::union_type>
     {
-        std::vector<node*> types;
+        explicit union_type(allocator alloc) : types(alloc) {}
+
+        list<node*> types;
     };
 
-    struct intersection_type : node
+    struct intersection_type : basic_node<node_kind::intersection_type>
     {
-        std::vector<node*> types;
+        explicit intersection_type(allocator alloc) : types(alloc) {}
+
+        list<node*> types;
     };
 
-    struct literal_type : node
+    struct literal_type : basic_node<node_kind::literal_type>
     {
-        std::string value;
+        std::string_view value;
         bool is_string = false;
         bool is_number = false;
     };
 
-    struct tuple_type : node
+    struct tuple_type : basic_node<node_kind::tuple_type>
     {
-        std::vector<node*> elements;
+        explicit tuple_type(allocator alloc) : elements(alloc) {}
+
+        list<node*> elements;
     };
 
-    struct template_literal_type : node
+    struct template_literal_type : basic_node<node_kind::template_literal_type>
     {
-        std::string value;
+        std::string_view value;
     };
 
-    struct generic_type_reference : node
+    struct generic_type_reference : basic_node<node_kind::generic_type_reference>
     {
-        std::string name;
-        std::vector<node*> arguments;
+        explicit generic_type_reference(allocator alloc) : arguments(alloc) {}
+
+        std::string_view name;
+        symbol_id name_id = invalid_symbol;
+        list<node*> arguments;
     };
 
-    struct mapped_type : node
+    struct mapped_type : basic_node<node_kind::mapped_type>
     {
         node* key_type = nullptr;
         node* value_type = nullptr;
     };
 
-    struct conditional_type : node
+    struct conditional_type : basic_node<node_kind::conditional_type>
     {
         node* condition = nullptr;
         node* extends_type = nullptr;
         node* true_type = nullptr;
         node* false_type = nullptr;
     };
+
+    /**
+     * @brief Returns the node as a T if that is its concrete type, or nullptr otherwise (including when n is null).
+     */
+    template <typename T>
+    T* node_cast(node* n) noexcept
+    {
+        return (n && (n->kind == T::static_kind)) ? static_cast<T*>(n) : nullptr;
+    }
+
+    /**
+     * @brief Calls vis with the node downcast to its concrete type. The visitor must accept a pointer to every node
+     * type, e.g. through a generic fallback overload.
+     */
+    template <typename Visitor>
+    decltype(auto) visit(node* n, Visitor&& vis)
+    {
+        switch (n->kind)
+        {
+        case node_kind::file: return vis(static_cast<file*>(n));
+        case node_kind::import_stmt: return vis(static_cast<import_stmt*>(n));
+        case node_kind::module: return vis(static_cast<module*>(n));
+        case node_kind::member: return vis(static_cast<member*>(n));
+        case node_kind::object: return vis(static_cast<object*>(n));
+        case node_kind::interface: return vis(static_cast<interface*>(n));
+        case node_kind::interface_reference: return vis(static_cast<interface_reference*>(n));
+        case node_kind::fundamental_type_reference: return vis(static_cast<fundamental_type_reference*>(n));
+        case node_kind::array: return vis(static_cast<array*>(n));
+        case node_kind::enumeration: return vis(static_cast<enumeration*>(n));
+        case node_kind::type_alias: return vis(static_cast<type_alias*>(n));
+        case node_kind::union_type: return vis(static_cast<union_type*>(n));
+        case node_kind::intersection_type: return vis(static_cast<intersection_type*>(n));
+        case node_kind::literal_type: return vis(static_cast<literal_type*>(n));
+        case node_kind::tuple_type: return vis(static_cast<tuple_type*>(n));
+        case node_kind::template_literal_type: return vis(static_cast<template_literal_type*>(n));
+        case node_kind::generic_type_reference: return vis(static_cast<generic_type_reference*>(n));
+        case node_kind::mapped_type: return vis(static_cast<mapped_type*>(n));
+        case node_kind::conditional_type: break;
+        }
+
+        // Kept outside of the switch so that every path returns
+        return vis(static_cast<conditional_type*>(n));
+    }
+
+    /**
+     * @brief The name a top-level interface, type alias or enum can be referred to by, or invalid_symbol for anything
+     * else.
+     */
+    symbol_id declared_name(const node* n) noexcept;
+
+    /**
+     * @brief Appends the id of every name that a declaration or type refers to, including the names inside nested
+     * types. May contain duplicates.
+     */
+    void collect_references(const node* n, std::vector<symbol_id>& references);
+
+    /**
+     * @brief Deep-copies a declaration or type into another file, interning its names there.
+     *
+     * Names and literal values still view the original file's source text, so that file must outlive the copy.
+     */
+    node* clone(file& target, const node* n);
 }
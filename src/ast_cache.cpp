@@ -0,0 +1,545 @@
+#include "ast_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+#include "file_io.h"
+#include "output_cache.h"
+#include "parser.h"
+#include "source_buffer.h"
+
+// An entry is a sequence of numbers, each written as a LEB128 varint so that the many small ones take a byte:
+//
+//   header      magic, format_version, source size, strict, symbol count, children count
+//   symbols     one string per interned name after the builtins, in id order
+//   children    one record per top-level node
+//
+// A record is a number holding the node kind and its flags, then the node's fields, with child nodes and lists of them
+// written as nested records in place; a list is its length followed by that many records. A null node is the single
+// number null_record. Symbol ids are written plus one, so that invalid_symbol is 0. A string is its length and where
+// it starts in the source, the latter relative to where the previous string ended (zigzag-encoded, as it may go
+// backwards); names appear in about the order they do in the source, so that's mostly a single byte too.
+
+static constexpr std::uint32_t magic = 0x54534153; // "TSAS"
+
+// Changed whenever the layout of an entry changes, so that older entries are never misread
+static constexpr std::uint32_t format_version = 1;
+
+static constexpr std::uint32_t null_record = 0x1f;
+
+// Record flags, above the kind, which takes the low five bits. flag_export, flag_optional and flag_string are the same
+// bit: each kind of record uses at most one of them, so it can't be misread as another, and every header fits in a byte.
+static constexpr std::uint32_t flag_none = 0;
+static constexpr std::uint32_t flag_export = 1u << 5;   // Modules, interfaces, enums and type aliases
+static constexpr std::uint32_t flag_optional = 1u << 5; // Members
+static constexpr std::uint32_t flag_string = 1u << 5;   // Literals
+static constexpr std::uint32_t flag_number = 1u << 6;   // Literals
+static_assert(static_cast<std::uint32_t>(ast::node_kind::conditional_type) < null_record, "Node kinds need more bits");
+
+/**
+ * @brief Appends the records for a tree to an entry.
+ */
+struct ast_writer
+{
+    std::string& out;
+    std::string_view source;
+    std::uint32_t last_end = 0; // Where the previous string ended
+    bool ok = true;
+
+    void number(std::uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void symbol(ast::symbol_id id) { number(id + 1); }
+
+    void string(std::string_view text)
+    {
+        // Empty text may view anything, including nothing at all
+        if (text.empty()) {
+            number(0);
+            return;
+        }
+
+        // Compared as addresses, as the text is only meaningful as part of the source
+        const auto begin = reinterpret_cast<std::uintptr_t>(source.data());
+        const auto address = reinterpret_cast<std::uintptr_t>(text.data());
+        if (address < begin || address - begin > source.size() || text.size() > source.size() - (address - begin))
+        {
+            ok = false;
+            return;
+        }
+        const auto offset = static_cast<std::uint32_t>(address - begin);
+        const auto delta = static_cast<std::int32_t>(offset - last_end);
+        number(static_cast<std::uint32_t>(text.size()));
+        number((static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31));
+        last_end = offset + static_cast<std::uint32_t>(text.size());
+    }
+
+    template <typename T>
+    void list(const ast::list<T*>& nodes)
+    {
+        number(static_cast<std::uint32_t>(nodes.size()));
+        for (auto* n : nodes) node(n);
+    }
+
+    void node(const ast::node* n)
+    {
+        if (!n) {
+            number(null_record);
+            return;
+        }
+
+        auto header = [&](std::uint32_t flags) { number(static_cast<std::uint32_t>(n->kind) | flags); };
+        switch (n->kind)
+        {
+        case ast::node_kind::file:
+            ok = false;
+            break;
+        case ast::node_kind::import_stmt:
+            header(flag_none);
+            string(static_cast<const ast::import_stmt*>(n)->module_name);
+            break;
+        case ast::node_kind::module: {
+            auto* mod = static_cast<const ast::module*>(n);
+            header(mod->is_export ? flag_export : flag_none);
+            string(mod->name);
+            list(mod->children);
+            break;
+        }
+        case ast::node_kind::member: {
+            auto* m = static_cast<const ast::member*>(n);
+            header(m->is_optional ? flag_optional : flag_none);
+            string(m->name);
+            node(m->type);
+            break;
+        }
+        case ast::node_kind::object:
+            header(flag_none);
+            list(static_cast<const ast::object*>(n)->named_members);
+            break;
+        case ast::node_kind::interface: {
+            auto* iface = static_cast<const ast::interface*>(n);
+            header(iface->is_export ? flag_export : flag_none);
+            string(iface->name);
+            symbol(iface->name_id);
+            list(iface->base);
+            node(iface->definition);
+            break;
+        }
+        case ast::node_kind::interface_reference: {
+            auto* ref = static_cast<const ast::interface_reference*>(n);
+            header(flag_none);
+            string(ref->name);
+            symbol(ref->name_id);
+            break;
+        }
+        case ast::node_kind::fundamental_type_reference:
+            header(flag_none);
+            number(static_cast<std::uint32_t>(static_cast<const ast::fundamental_type_reference*>(n)->type));
+            break;
+        case ast::node_kind::array:
+            header(flag_none);
+            node(static_cast<const ast::array*>(n)->type);
+            break;
+        case ast::node_kind::enumeration: {
+            auto* en = static_cast<const ast::enumeration*>(n);
+            header(en->is_export ? flag_export : flag_none);
+            string(en->name);
+            symbol(en->name_id);
+            number(static_cast<std::uint32_t>(en->members.size()));
+            for (const auto& member : en->members)
+            {
+                string(member.name);
+                string(member.value);
+            }
+            break;
+        }
+        case ast::node_kind::type_alias: {
+            auto* alias = static_cast<const ast::type_alias*>(n);
+            header(alias->is_export ? flag_export : flag_none);
+            string(alias->name);
+            symbol(alias->name_id);
+            node(alias->target_type);
+            break;
+        }
+        case ast::node_kind::union_type:
+            header(flag_none);
+            list(static_cast<const ast::union_type*>(n)->types);
+            break;
+        case ast::node_kind::intersection_type:
+            header(flag_none);
+            list(static_cast<const ast::intersection_type*>(n)->types);
+            break;
+        case ast::node_kind::literal_type: {
+            auto* lit = static_cast<const ast::literal_type*>(n);
+            header((lit->is_string ? flag_string : flag_none) | (lit->is_number ? flag_number : flag_none));
+            string(lit->value);
+            break;
+        }
+        case ast::node_kind::tuple_type:
+            header(flag_none);
+            list(static_cast<const ast::tuple_type*>(n)->elements);
+            break;
+        case ast::node_kind::template_literal_type:
+            header(flag_none);
+            string(static_cast<const ast::template_literal_type*>(n)->value);
+            break;
+        case ast::node_kind::generic_type_reference: {
+            auto* gref = static_cast<const ast::generic_type_reference*>(n);
+            header(flag_none);
+            string(gref->name);
+            symbol(gref->name_id);
+            list(gref->arguments);
+            break;
+        }
+        case ast::node_kind::mapped_type: {
+            auto* mapped = static_cast<const ast::mapped_type*>(n);
+            header(flag_none);
+            node(mapped->key_type);
+            node(mapped->value_type);
+            break;
+        }
+        case ast::node_kind::conditional_type: {
+            auto* cond = static_cast<const ast::conditional_type*>(n);
+            header(flag_none);
+            node(cond->condition);
+            node(cond->extends_type);
+            node(cond->true_type);
+            node(cond->false_type);
+            break;
+        }
+        }
+    }
+};
+
+bool serialize_ast(const ast::file& file, std::string_view source, std::string& out)
+{
+    // Offsets into the source are 32 bits
+    if (source.size() > UINT32_MAX) return false;
+
+    ast_writer writer{ out, source };
+    writer.number(magic);
+    writer.number(format_version);
+    writer.number(static_cast<std::uint32_t>(source.size()));
+    writer.number(file.strict ? 1 : 0);
+    writer.number(static_cast<std::uint32_t>(file.symbols.size()));
+    writer.number(static_cast<std::uint32_t>(file.children.size()));
+
+    for (auto id = static_cast<ast::symbol_id>(ast::builtin::count); id < file.symbols.size(); ++id)
+    {
+        writer.string(file.symbols.name(id));
+    }
+    for (auto* child : file.children) writer.node(child);
+    return writer.ok;
+}
+
+/**
+ * @brief Rebuilds a tree from the records of an entry, checking every number it reads.
+ *
+ * Records nest no deeper than the parser recursed to produce them, so they're read recursively too.
+ */
+struct ast_reader
+{
+    ast::file& file;
+    std::string_view source;
+    const char* cursor;
+    const char* end;
+    std::uint32_t symbol_count = 0;
+    std::uint32_t last_end = 0;
+    bool ok = true;
+
+    std::uint32_t number()
+    {
+        std::uint32_t value = 0;
+        for (unsigned shift = 0; cursor != end && shift < 35; shift += 7)
+        {
+            const auto byte = static_cast<unsigned char>(*cursor++);
+            value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    std::string_view string()
+    {
+        const auto length = number();
+        if (length == 0) return {};
+
+        const auto zigzag = number();
+        const auto delta = static_cast<std::uint32_t>(zigzag >> 1) ^ (0u - (zigzag & 1));
+        const auto offset = last_end + delta;
+        if (offset > source.size() || length > source.size() - offset) {
+            ok = false;
+            return {};
+        }
+        last_end = offset + length;
+        return source.substr(offset, length);
+    }
+
+    ast::symbol_id symbol()
+    {
+        const auto id = number() - 1;
+        if (id >= symbol_count && id != ast::invalid_symbol) ok = false;
+        return id;
+    }
+
+    // Every element takes at least a byte, so a corrupt count can't make the reader allocate without bound
+    std::uint32_t count()
+    {
+        const auto n = number();
+        if (n > static_cast<std::size_t>(end - cursor)) {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+
+    template <typename T>
+    void list(ast::list<T*>& nodes, ast::node* parent)
+    {
+        const auto n = count();
+        nodes.reserve(n);
+        for (std::uint32_t i = 0; i < n && ok; ++i)
+        {
+            auto* child = node(parent);
+            if constexpr (!std::is_same_v<T, ast::node>)
+            {
+                if (child && child->kind != T::static_kind) {
+                    ok = false;
+                    return;
+                }
+            }
+            nodes.push_back(static_cast<T*>(child));
+        }
+    }
+
+    ast::node* node(ast::node* parent)
+    {
+        const auto header = number();
+        if (!ok || header == null_record) return nullptr;
+
+        ast::node* result = nullptr;
+        switch (static_cast<ast::node_kind>(header & null_record))
+        {
+        case ast::node_kind::import_stmt: {
+            auto* imp = file.make<ast::import_stmt>();
+            imp->module_name = string();
+            result = imp;
+            break;
+        }
+        case ast::node_kind::module: {
+            auto* mod = file.make<ast::module>();
+            mod->is_export = (header & flag_export) != 0;
+            mod->name = string();
+            list(mod->children, mod);
+            result = mod;
+            break;
+        }
+        case ast::node_kind::member: {
+            auto* m = file.make<ast::member>();
+            m->is_optional = (header & flag_optional) != 0;
+            m->name = string();
+            m->type = node(m);
+            result = m;
+            break;
+        }
+        case ast::node_kind::object: {
+            auto* obj = file.make<ast::object>();
+            list(obj->named_members, obj);
+            result = obj;
+            break;
+        }
+        case ast::node_kind::interface: {
+            auto* iface = file.make<ast::interface>();
+            iface->is_export = (header & flag_export) != 0;
+            iface->name = string();
+            iface->name_id = symbol();
+            list(iface->base, iface);
+            auto* definition = node(iface);
+            iface->definition = ast::node_cast<ast::object>(definition);
+            if (definition && !iface->definition) ok = false;
+            result = iface;
+            break;
+        }
+        case ast::node_kind::interface_reference: {
+            auto* ref = file.make<ast::interface_reference>();
+            ref->name = string();
+            ref->name_id = symbol();
+            result = ref;
+            break;
+        }
+        case ast::node_kind::fundamental_type_reference: {
+            const auto type = number();
+            if (type > static_cast<std::uint32_t>(ast::fundamental_type::never)) ok = false;
+            result = file.make<ast::fundamental_type_reference>(static_cast<ast::fundamental_type>(type));
+            break;
+        }
+        case ast::node_kind::array: {
+            auto* arr = file.make<ast::array>();
+            arr->type = node(arr);
+            result = arr;
+            break;
+        }
+        case ast::node_kind::enumeration: {
+            auto* en = file.make<ast::enumeration>();
+            en->is_export = (header & flag_export) != 0;
+            en->name = string();
+            en->name_id = symbol();
+            const auto n = count();
+            en->members.reserve(n);
+            for (std::uint32_t i = 0; i < n && ok; ++i)
+            {
+                auto name = string();
+                en->members.push_back({ name, string() });
+            }
+            result = en;
+            break;
+        }
+        case ast::node_kind::type_alias: {
+            auto* alias = file.make<ast::type_alias>();
+            alias->is_export = (header & flag_export) != 0;
+            alias->name = string();
+            alias->name_id = symbol();
+            alias->target_type = node(alias);
+            result = alias;
+            break;
+        }
+        case ast::node_kind::union_type: {
+            auto* u = file.make<ast::union_type>();
+            list(u->types, u);
+            result = u;
+            break;
+        }
+        case ast::node_kind::intersection_type: {
+            auto* i = file.make<ast::intersection_type>();
+            list(i->types, i);
+            result = i;
+            break;
+        }
+        case ast::node_kind::literal_type: {
+            auto* lit = file.make<ast::literal_type>();
+            lit->is_string = (header & flag_string) != 0;
+            lit->is_number = (header & flag_number) != 0;
+            lit->value = string();
+            result = lit;
+            break;
+        }
+        case ast::node_kind::tuple_type: {
+            auto* tuple = file.make<ast::tuple_type>();
+            list(tuple->elements, tuple);
+            result = tuple;
+            break;
+        }
+        case ast::node_kind::template_literal_type: {
+            auto* tmpl = file.make<ast::template_literal_type>();
+            tmpl->value = string();
+            result = tmpl;
+            break;
+        }
+        case ast::node_kind::generic_type_reference: {
+            auto* gref = file.make<ast::generic_type_reference>();
+            gref->name = string();
+            gref->name_id = symbol();
+            list(gref->arguments, gref);
+            result = gref;
+            break;
+        }
+        case ast::node_kind::mapped_type: {
+            auto* mapped = file.make<ast::mapped_type>();
+            mapped->key_type = node(mapped);
+            mapped->value_type = node(mapped);
+            result = mapped;
+            break;
+        }
+        case ast::node_kind::conditional_type: {
+            auto* cond = file.make<ast::conditional_type>();
+            cond->condition = node(cond);
+            cond->extends_type = node(cond);
+            cond->true_type = node(cond);
+            cond->false_type = node(cond);
+            result = cond;
+            break;
+        }
+        default:
+            ok = false;
+            return nullptr;
+        }
+
+        result->parent = parent;
+        return result;
+    }
+};
+
+std::unique_ptr<ast::file> deserialize_ast(std::string_view data, std::string_view source)
+{
+    auto file = std::make_unique<ast::file>();
+    ast_reader reader{ *file, source, data.data(), data.data() + data.size() };
+
+    if (reader.number() != magic || reader.number() != format_version ||
+        reader.number() != static_cast<std::uint32_t>(source.size()))
+    {
+        return nullptr;
+    }
+    file->strict = (reader.number() != 0);
+    reader.symbol_count = reader.number();
+    const auto children = reader.count();
+    if (!reader.ok || reader.symbol_count < ast::builtin::count) return nullptr;
+
+    // Interned in the same order, so every name gets back the id the records refer to it by
+    file->symbols.reserve(std::min<std::size_t>(reader.symbol_count, data.size()));
+    for (auto id = static_cast<ast::symbol_id>(ast::builtin::count); id < reader.symbol_count && reader.ok; ++id)
+    {
+        if (file->symbols.intern(reader.string()) != id) return nullptr;
+    }
+
+    file->children.reserve(children);
+    for (std::uint32_t i = 0; i < children && reader.ok; ++i)
+    {
+        if (auto* child = reader.node(file.get())) file->children.push_back(child);
+    }
+    if (!reader.ok || reader.cursor != reader.end) return nullptr;
+    return file;
+}
+
+ast_cache::ast_cache(std::filesystem::path directory) : directory(std::move(directory))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(this->directory, ec);
+    is_usable = std::filesystem::is_directory(this->directory, ec);
+}
+
+std::unique_ptr<ast::file> ast_cache::parse(std::unique_ptr<source_buffer> source, std::ostream& diagnostics)
+{
+    if (!is_usable) return parse_file(std::move(source), diagnostics);
+
+    // The tree depends on nothing but the text and the parser, so the tool version stands in for the parser
+    static constexpr std::string_view key_prefix = "ast-entry\n" TS_TYPE_CONV_VERSION "\n";
+    const auto hash = content_hasher().update(key_prefix).update(source->text()).digest();
+    const auto path = directory / (hash.hex() + ".ast");
+
+    if (auto entry = source_buffer::map_file(path.string()))
+    {
+        if (auto file = deserialize_ast(entry->text(), source->text()))
+        {
+            file->source = std::move(source);
+            ++hit_count;
+            return file;
+        }
+    }
+    ++miss_count;
+
+    auto file = parse_file(std::move(source), diagnostics);
+    std::string entry;
+    if (file && serialize_ast(*file, file->source->text(), entry)) replace_file(path, entry, std::ios::binary);
+    return file;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.h"
+
+/**
+ * @brief Writes a parsed file's tree and interned names in the binary form the AST cache stores.
+ *
+ * Names and literal values are recorded as offsets into the file's source text rather than copied, so the result is
+ * only meaningful alongside that same text.
+ *
+ * @return False if the tree can't be stored, because some of its text isn't part of the source.
+ */
+bool serialize_ast(const ast::file& file, std::string_view source, std::string& out);
+
+/**
+ * @brief Rebuilds a tree written by serialize_ast, with its names and values viewing 'source' again.
+ *
+ * Node ids are numbered afresh in the order the tree is walked, so they may differ from the original's.
+ *
+ * @return The rebuilt file, which doesn't own 'source', or nullptr if the data is malformed or was written for other
+ * source text.
+ */
+std::unique_ptr<ast::file> deserialize_ast(std::string_view data, std::string_view source);
+
+/**
+ * @brief Parsed trees stored on disk in binary form, keyed by a hash of the source text they were parsed from.
+ *
+ * Loading a file that has been parsed before maps its entry and rebuilds the tree from it, which costs far less than
+ * lexing and parsing the text again. Any change to the text changes the key, so stale entries are never used. Entries
+ * are replaced atomically, so several processes or threads can share one directory. Safe to use from several threads
+ * at once.
+ */
+class ast_cache
+{
+public:
+    /**
+     * @param directory Where entries are stored; created if it doesn't exist.
+     */
+    explicit ast_cache(std::filesystem::path directory);
+
+    /**
+     * @brief Returns false if the cache directory couldn't be created, in which case every file is parsed.
+     */
+    bool usable() const noexcept { return is_usable; }
+
+    /**
+     * @brief Loads the tree stored for the source if there is one, and otherwise parses it and stores the result.
+     *
+     * @return The file, owning 'source', or nullptr if it failed to parse.
+     */
+    std::unique_ptr<ast::file> parse(std::unique_ptr<source_buffer> source, std::ostream& diagnostics);
+
+    std::size_t hits() const noexcept { return hit_count; }
+    std::size_t misses() const noexcept { return miss_count; }
+
+private:
+    std::filesystem::path directory;
+    bool is_usable = false;
+
+    std::atomic<std::size_t> hit_count{ 0 };
+    std::atomic<std::size_t> miss_count{ 0 };
+};
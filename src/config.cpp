@@ -3,66 +3,88 @@
 #include <iostream>
 #include "toml.hpp"
 
-bool parse_config(const std::string& config_file, codegen_config& conf, std::string& string_format)
+/**
+ * @brief Reads the settings out of a parsed configuration table.
+ */
+static bool read_config(toml::table& tbl, codegen_config& conf, std::string& string_format, std::ostream& diagnostics)
 {
-    if (config_file.empty())
+    if (auto format_val = tbl.get("format"))
     {
-        return true;
-    }
-
-    try
-    {
-        toml::table tbl = toml::parse_file(config_file);
-
-        if (auto format_val = tbl.get("format"))
+        if (auto format_str = format_val->value<std::string>())
         {
-            if (auto format_str = format_val->value<std::string>())
+            if (*format_str != "cpp" && *format_str != "proto")
             {
-                if (*format_str != "cpp" && *format_str != "proto")
-                {
-                    std::cerr << "ERROR: format '" << *format_str << "' is not supported. Only 'cpp' and 'proto' formts are supported.\n";
-                    return false;
-                }
-                string_format = *format_str;
+                diagnostics << "ERROR: format '" << *format_str << "' is not supported. Only 'cpp' and 'proto' formts are supported.\n";
+                return false;
             }
+            string_format = *format_str;
         }
+    }
 
-        if (auto cpp_tbl = tbl["cpp"].as_table())
+    if (auto cpp_tbl = tbl["cpp"].as_table())
+    {
+        if (auto enum_val = cpp_tbl->get("enum"))
         {
-            if (auto enum_val = cpp_tbl->get("enum"))
+            if (auto enum_str = enum_val->value<std::string>())
             {
-                if (auto enum_str = enum_val->value<std::string>())
-                {
-                    if (*enum_str == "withArray") conf.cpp.enum_mode = enum_generation_mode::with_array;
-                }
+                if (*enum_str == "withArray") conf.cpp.enum_mode = enum_generation_mode::with_array;
             }
         }
+    }
 
-        if (auto datatypes = tbl["datatype"].as_table())
+    if (auto datatypes = tbl["datatype"].as_table())
+    {
+        for (auto& kv : *datatypes)
         {
-            for (auto& kv : *datatypes)
+            if (auto dt_table = kv.second.as_table())
             {
-                if (auto dt_table = kv.second.as_table())
+                datatype_config entry;
+                if (auto out_val = dt_table->get("out"))
                 {
-                    datatype_config entry;
-                    if (auto out_val = dt_table->get("out"))
-                    {
-                        if (auto out_str = out_val->value<std::string>()) entry.out = *out_str;
-                    }
-                    if (auto h_val = dt_table->get("header"))
-                    {
-                        if (auto header_str = h_val->value<std::string>()) entry.header = *header_str;
-                    }
-                    conf.datatypes[std::string(kv.first.str())] = entry;
+                    if (auto out_str = out_val->value<std::string>()) entry.out = *out_str;
                 }
+                if (auto h_val = dt_table->get("header"))
+                {
+                    if (auto header_str = h_val->value<std::string>()) entry.header = *header_str;
+                }
+                conf.datatypes[std::string(kv.first.str())] = entry;
             }
         }
     }
+
+    return true;
+}
+
+bool parse_config(const std::string& config_file, codegen_config& conf, std::string& string_format)
+{
+    if (config_file.empty())
+    {
+        return true;
+    }
+
+    try
+    {
+        toml::table tbl = toml::parse_file(config_file);
+        return read_config(tbl, conf, string_format, std::cerr);
+    }
     catch (const toml::parse_error& err)
     {
         std::cerr << "ERROR parsing config file: " << err << "\n";
         return false;
     }
+}
 
-    return true;
+bool parse_config_text(std::string_view text, codegen_config& conf, std::string& string_format,
+    std::ostream& diagnostics)
+{
+    try
+    {
+        toml::table tbl = toml::parse(text);
+        return read_config(tbl, conf, string_format, diagnostics);
+    }
+    catch (const toml::parse_error& err)
+    {
+        diagnostics << "ERROR parsing config: " << err << "\n";
+        return false;
+    }
 }
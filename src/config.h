@@ -1,8 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <iosfwd>
 #include <map>
 #include <string>
+#include <string_view>
 
 /**
  * @brief Configuration relating to specific data types and overriding their output generation.
@@ -31,7 +33,7 @@ struct cpp_config {
  * @brief Centralized configuration options for the ts-type-conv code generation processes.
  */
 struct codegen_config {
-    std::map<std::string, datatype_config> datatypes;
+    std::map<std::string, datatype_config, std::less<>> datatypes;
     cpp_config cpp;
 };
 
@@ -44,3 +46,13 @@ struct codegen_config {
  * @return True if parsing succeeded or there was no config_file, false if a parsing error occurred.
  */
 bool parse_config(const std::string& config_file, codegen_config& conf, std::string& string_format);
+
+/**
+ * @brief Parses TOML configuration text already in memory, as parse_config does for a file.
+ *
+ * @param text The configuration text. Empty text gives the default settings.
+ * @param diagnostics Where parse errors and unsupported settings are reported.
+ * @return True if parsing succeeded, false if a parsing error occurred.
+ */
+bool parse_config_text(std::string_view text, codegen_config& conf, std::string& string_format,
+    std::ostream& diagnostics);
@@ -0,0 +1,23 @@
+#include "stats.h"
+
+#include <cstdlib>
+#include <new>
+
+// Linked into the executable only; see allocation_count
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,651 @@
+#include "driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include "file_io.h"
+#include "file_watcher.h"
+#include "incremental.h"
+#include "lexer.h"
+#include "module_graph.h"
+#include "output_cache.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "source_buffer.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "emit/codegen_cpp.h"
+#include "emit/codegen_proto.h"
+
+/**
+ * @brief Writes the comment naming the input that C++ output starts with. It isn't part of what's cached, so that
+ * identical inputs at different paths can share an entry.
+ */
+static void write_preamble(const std::string& input, const std::string& format, std::ostream& out)
+{
+    if (format != "proto") {
+        out << "/* Generated C++ Header from " << (input == "-" ? "stdin" : input) << " */\n";
+    }
+}
+
+/**
+ * @brief Lexes the whole text without parsing it, and returns the number of tokens.
+ */
+static std::size_t count_tokens(std::string_view text)
+{
+    ast::file scratch;
+    std::ostringstream ignored;
+    std::size_t count = 0;
+    for (lexer lex(text, &scratch, ignored); lex; lex.advance()) ++count;
+    return count;
+}
+
+/**
+ * @brief Writes the complete output for a job's source text to 'out', from the cache if possible.
+ *
+ * @param stats Receives the time taken by each phase and the sizes involved, if not null.
+ */
+static bool generate_output(const conversion_job& job, const conversion_settings& settings, std::string_view text,
+    std::ostream& out, std::ostream& diagnostics, file_stats* stats = nullptr)
+{
+    if (stats) stats->bytes_in = text.size();
+
+    // Relative imports, and the cached dependencies recorded for them, are relative to the input's directory
+    std::filesystem::path directory;
+    if (job.input != "-") directory = std::filesystem::path(job.input).parent_path();
+    if (directory.empty()) directory = ".";
+
+	// Reuse Cached Output
+    std::string cached;
+    if (settings.cache && settings.cache->load(text, cached, directory))
+    {
+        write_preamble(job.input, settings.format, out);
+        out << cached;
+        if (stats) stats->cached = true;
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (stats)
+    {
+        stats->tokens = count_tokens(text);
+        stats->lex_ms = elapsed_ms(start);
+        start = std::chrono::steady_clock::now();
+    }
+
+	// Resolve Imported Declarations, once the file is parsed
+    std::vector<const source_module*> imports;
+    std::vector<std::string> missing;
+    double written_ms = 0;
+    auto after_parse = [&](ast::file& parsed) {
+        // Only once the parse has succeeded, so that a failed conversion writes nothing. The C++ generators write
+        // nothing before this is called, and proto output has no preamble.
+        write_preamble(job.input, settings.format, out);
+        if (stats)
+        {
+            stats->parse_ms = elapsed_ms(start);
+            count_nodes(&parsed, stats->nodes);
+            start = std::chrono::steady_clock::now();
+        }
+        if (settings.modules)
+        {
+            imports = settings.modules->load_imports(parsed, directory, missing, diagnostics);
+            module_graph::link(parsed, imports);
+        }
+        if (stats)
+        {
+            stats->imports_ms = elapsed_ms(start);
+            start = std::chrono::steady_clock::now();
+            written_ms = stats->write_ms;
+        }
+    };
+
+	// Parse Input File and Generate Output
+    std::ostringstream generated;
+    std::ostream& gen_stream = settings.cache ? generated : out;
+    std::unique_ptr<ast::file> file;
+    if (settings.pipeline)
+    {
+        // Generation overlaps the parse, so only what's left of it once the parse has finished is timed as generating
+        file = parse_and_generate(text, settings.format, settings.config, after_parse, gen_stream, diagnostics);
+    }
+    else if ((file = parse_file(text, diagnostics)))
+    {
+        after_parse(*file);
+        if (settings.format == "proto") {
+            generate_proto(gen_stream, file.get(), settings.config);
+        } else {
+            generate_cpp(gen_stream, file.get(), settings.config, settings.generate_threads);
+        }
+    }
+    if (!file)
+    {
+        diagnostics << "Error encountered while parsing file '" << job.input << "'; aborting\n";
+        return false;
+    }
+
+    // Output streamed to a file as it's generated is timed as writing rather than generating
+    if (stats) stats->generate_ms = elapsed_ms(start) - (stats->write_ms - written_ms);
+
+    if (settings.cache)
+    {
+        const std::string output = generated.str();
+        settings.cache->store(text, output, module_graph::dependencies(imports, missing, directory));
+        out << output;
+    }
+    return true;
+}
+
+/**
+ * @brief Replaces the file at 'path' with 'contents', unless it already holds exactly that.
+ *
+ * Leaving an up-to-date file alone keeps its timestamp, so nothing that depends on it is rebuilt.
+ */
+static bool write_if_changed(const std::string& path, const std::string& contents, std::ostream& diagnostics)
+{
+    std::string existing;
+    if (read_file(path, existing) && existing == contents) return true;
+
+    if (!replace_file(path, contents))
+    {
+        diagnostics << "ERROR: Failed to write output file '" << path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Generates a job's output straight into its output file, which is written in large blocks as it goes rather
+ * than once the whole output has been built in memory.
+ *
+ * @param stats Also receives the time spent writing and the size of the output, if not null.
+ */
+static bool stream_to_file(const conversion_job& job, const conversion_settings& settings, std::string_view text,
+    std::ostream& diagnostics, file_stats* stats = nullptr)
+{
+    file_writer writer(stats ? &stats->write_ms : nullptr);
+    if (!writer.open(job.output))
+    {
+        diagnostics << "ERROR: Failed to open output file '" << job.output << "'\n";
+        return false;
+    }
+
+    std::ostream out(&writer);
+    const bool generated = generate_output(job, settings, text, out, diagnostics, stats);
+
+    // Pipelined proto output is streamed while the file is still being parsed, so a late syntax error can leave some
+    if (!generated) writer.discard();
+    const bool written = writer.close();
+    if (stats) stats->bytes_out = writer.bytes_written();
+    if (generated && !written)
+    {
+        diagnostics << "ERROR: Failed to write output file '" << job.output << "'\n";
+    }
+    return generated && written;
+}
+
+/**
+ * @brief Maps an input file into memory, or reads all of stdin if 'input' is "-".
+ */
+static std::unique_ptr<source_buffer> load_input(const std::string& input, std::ostream& diagnostics)
+{
+    if (input != "-")
+    {
+        auto source = source_buffer::map_file(input);
+        if (!source) diagnostics << "ERROR: Failed to open file '" << input << "'\n";
+        return source;
+    }
+
+    auto source = source_buffer::read_stream(std::cin);
+    if (!source) diagnostics << "ERROR: Failed to read from stdin\n";
+    return source;
+}
+
+bool convert_file(const conversion_job& job, const conversion_settings& settings, std::ostream& console,
+    std::ostream& diagnostics)
+{
+	// Load Input Buffer
+    auto source = load_input(job.input, diagnostics);
+    if (!source) return false;
+
+    if (settings.stats)
+    {
+        file_stats stats;
+        stats.input = job.input;
+        stats.output = job.output;
+        const auto allocations = thread_allocation_count();
+
+        if (job.output != "-" && !settings.write_if_changed)
+        {
+            stats.ok = stream_to_file(job, settings, source->text(), diagnostics, &stats);
+        }
+        else
+        {
+            // Generated in memory first, so that writing it out can be timed on its own
+            std::ostringstream buffer;
+            if (generate_output(job, settings, source->text(), buffer, diagnostics, &stats))
+            {
+                const auto start = std::chrono::steady_clock::now();
+                const std::string contents = buffer.str();
+                stats.ok = write_output(job, settings, contents, console, diagnostics);
+                stats.write_ms = elapsed_ms(start);
+                stats.bytes_out = contents.size();
+            }
+        }
+        stats.allocations = thread_allocation_count() - allocations;
+        const bool ok = stats.ok;
+        settings.stats->add(std::move(stats));
+        return ok;
+    }
+
+    if (settings.write_if_changed && job.output != "-")
+    {
+        std::ostringstream buffer;
+        return generate_output(job, settings, source->text(), buffer, diagnostics) &&
+            write_if_changed(job.output, buffer.str(), diagnostics);
+    }
+
+    if (job.output == "-")
+    {
+        if (!settings.pipeline) return generate_output(job, settings, source->text(), console, diagnostics);
+
+        // As in stream_to_file, a pipelined conversion that fails may already have generated some output
+        std::ostringstream buffer;
+        if (!generate_output(job, settings, source->text(), buffer, diagnostics)) return false;
+        console << buffer.str();
+        return true;
+    }
+    return stream_to_file(job, settings, source->text(), diagnostics);
+}
+
+bool write_output(const conversion_job& job, const conversion_settings& settings, const std::string& contents,
+    std::ostream& console, std::ostream& diagnostics)
+{
+    if (job.output == "-")
+    {
+        console << contents << std::flush;
+        return true;
+    }
+    if (settings.write_if_changed) return write_if_changed(job.output, contents, diagnostics);
+
+    if (!replace_file(job.output, contents))
+    {
+        diagnostics << "ERROR: Failed to write output file '" << job.output << "'\n";
+        return false;
+    }
+    return true;
+}
+
+bool convert_text(const std::string& name, std::string_view text, const conversion_settings& settings,
+    std::ostream& out, std::ostream& diagnostics)
+{
+    return generate_output({ name, "-" }, settings, text, out, diagnostics);
+}
+
+bool convert_file_to_outputs(const std::string& input, const std::vector<output_target>& outputs,
+    const conversion_settings& settings, std::ostream& console, std::ostream& diagnostics)
+{
+    auto source = load_input(input, diagnostics);
+    if (!source) return false;
+
+    file_stats stats;
+    const auto allocations = thread_allocation_count();
+    auto start = std::chrono::steady_clock::now();
+    if (settings.stats)
+    {
+        stats.input = input;
+        stats.bytes_in = source->text().size();
+        stats.tokens = count_tokens(source->text());
+        stats.lex_ms = elapsed_ms(start);
+        start = std::chrono::steady_clock::now();
+    }
+
+	// Parse Once, Resolving Imported Declarations
+    auto file = parse_file(source->text(), diagnostics);
+    if (!file)
+    {
+        diagnostics << "Error encountered while parsing file '" << input << "'; aborting\n";
+
+        // Emptied as a single output file is, so that none is left holding output from an earlier run
+        if (!settings.write_if_changed)
+        {
+            for (const auto& target : outputs)
+            {
+                file_writer writer;
+                if (target.path != "-" && !(writer.open(target.path) && writer.close()))
+                {
+                    diagnostics << "ERROR: Failed to open output file '" << target.path << "'\n";
+                }
+            }
+        }
+        return false;
+    }
+    if (settings.stats)
+    {
+        stats.parse_ms = elapsed_ms(start);
+        count_nodes(file.get(), stats.nodes);
+        start = std::chrono::steady_clock::now();
+    }
+    if (settings.modules)
+    {
+        auto directory = (input != "-") ? std::filesystem::path(input).parent_path() : std::filesystem::path();
+        if (directory.empty()) directory = ".";
+        std::vector<std::string> missing;
+        module_graph::link(*file, settings.modules->load_imports(*file, directory, missing, diagnostics));
+    }
+    if (settings.stats)
+    {
+        stats.imports_ms = elapsed_ms(start);
+        start = std::chrono::steady_clock::now();
+    }
+
+	// Generate Every Output From the Same Tree at Once
+    // The emitters only read the tree, so each runs on its own thread. Diagnostics, and output for the console, are
+    // buffered until all of them have finished so that they come out in the order the outputs were given.
+    struct output_result
+    {
+        bool ok = false;
+        std::size_t bytes_out = 0;
+        std::ostringstream console;
+        std::ostringstream diagnostics;
+    };
+    std::vector<output_result> results(outputs.size());
+
+    auto generate = [&](std::size_t i) {
+        const auto& target = outputs[i];
+        auto& result = results[i];
+        auto emit = [&](std::ostream& out) {
+            write_preamble(input, target.format, out);
+            if (target.format == "proto") {
+                generate_proto(out, file.get(), settings.config);
+            } else {
+                generate_cpp(out, file.get(), settings.config, settings.generate_threads);
+            }
+        };
+
+        if (target.path == "-")
+        {
+            emit(result.console);
+            result.ok = true;
+            result.bytes_out = static_cast<std::size_t>(result.console.tellp());
+        }
+        else if (settings.write_if_changed)
+        {
+            std::ostringstream buffer;
+            emit(buffer);
+            const std::string contents = buffer.str();
+            result.ok = write_if_changed(target.path, contents, result.diagnostics);
+            result.bytes_out = contents.size();
+        }
+        else
+        {
+            file_writer writer;
+            if (!writer.open(target.path))
+            {
+                result.diagnostics << "ERROR: Failed to open output file '" << target.path << "'\n";
+                return;
+            }
+            std::ostream out(&writer);
+            emit(out);
+            result.ok = writer.close();
+            result.bytes_out = writer.bytes_written();
+            if (!result.ok) result.diagnostics << "ERROR: Failed to write output file '" << target.path << "'\n";
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < outputs.size(); ++i) threads.emplace_back(generate, i);
+    if (!outputs.empty()) generate(0);
+    for (auto& thread : threads) thread.join();
+
+    bool ok = true;
+    for (const auto& result : results)
+    {
+        console << result.console.str() << std::flush;
+        diagnostics << result.diagnostics.str();
+        ok = ok && result.ok;
+        stats.bytes_out += result.bytes_out;
+    }
+
+    // The outputs are generated and written concurrently, so their wall time is all counted as generating
+    if (settings.stats)
+    {
+        stats.generate_ms = elapsed_ms(start);
+        for (const auto& target : outputs) stats.output += (stats.output.empty() ? "" : ", ") + target.path;
+        stats.ok = ok;
+        stats.allocations = thread_allocation_count() - allocations;
+        settings.stats->add(std::move(stats));
+    }
+    return ok;
+}
+
+std::string settings_fingerprint(const conversion_settings& settings)
+{
+    std::ostringstream out;
+    out << "ts-type-conv " << TS_TYPE_CONV_VERSION << "\n"
+        << "format=" << settings.format << "\n"
+        << "cpp.enum=" << static_cast<int>(settings.config.cpp.enum_mode) << "\n";
+    for (const auto& [name, dt] : settings.config.datatypes)
+    {
+        // Lengths first, so that no choice of names and values can produce the same text as another
+        out << "datatype " << name.size() << ':' << name << ' ' << dt.out.size() << ':' << dt.out << ' '
+            << dt.header.size() << ':' << dt.header << "\n";
+    }
+    return out.str();
+}
+
+/**
+ * @brief The buffered result of one job in a batch.
+ */
+struct job_result
+{
+    bool ok = false;
+    std::ostringstream console;
+    std::ostringstream diagnostics;
+};
+
+std::size_t run_batch(const std::vector<conversion_job>& jobs, std::size_t thread_count, const job_converter& convert,
+    std::ostream& console, std::ostream& diagnostics)
+{
+    std::vector<job_result> results(jobs.size());
+    auto run = [&](std::size_t i) {
+        results[i].ok = convert(jobs[i], results[i].console, results[i].diagnostics);
+    };
+
+    if (thread_count == 1 || jobs.size() <= 1)
+    {
+        for (std::size_t i = 0; i < jobs.size(); ++i) run(i);
+    }
+    else
+    {
+        work_stealing_pool pool(thread_count);
+        for (std::size_t i = 0; i < jobs.size(); ++i) pool.submit([&run, i] { run(i); });
+        pool.wait();
+    }
+
+    std::size_t failed = 0;
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        auto& result = results[i];
+        console << result.console.str();
+        diagnostics << result.diagnostics.str();
+        if (result.ok) {
+            diagnostics << "OK: " << jobs[i].input << " -> " << jobs[i].output << "\n";
+        } else {
+            diagnostics << "FAILED: " << jobs[i].input << "\n";
+            ++failed;
+        }
+    }
+    diagnostics << (jobs.size() - failed) << " of " << jobs.size() << " files converted\n";
+    return failed;
+}
+
+std::size_t convert_batch(const std::vector<conversion_job>& jobs, const conversion_settings& settings,
+    std::size_t thread_count, std::ostream& console, std::ostream& diagnostics)
+{
+    auto convert = [&](const conversion_job& job, std::ostream& job_console, std::ostream& job_diagnostics) {
+        return convert_file(job, settings, job_console, job_diagnostics);
+    };
+    return run_batch(jobs, thread_count, convert, console, diagnostics);
+}
+
+/**
+ * @brief Reads a watched input into memory. Mapping it instead would let an editor saving in place change the text
+ * that the previous statements' AST still points into.
+ */
+static std::unique_ptr<source_buffer> read_watched_input(const std::string& path)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (input.fail()) return nullptr;
+    return source_buffer::read_stream(input);
+}
+
+bool watch_files(const std::vector<conversion_job>& jobs, const conversion_settings& settings, std::ostream& console,
+    std::ostream& diagnostics)
+{
+    std::vector<std::string> inputs;
+    std::vector<std::unique_ptr<incremental_file>> files;
+    for (const auto& job : jobs)
+    {
+        if (job.input == "-")
+        {
+            diagnostics << "ERROR: Cannot watch stdin for changes\n";
+            return false;
+        }
+        inputs.push_back(job.input);
+        auto directory = std::filesystem::path(job.input).parent_path();
+        files.push_back(std::make_unique<incremental_file>(settings, directory.empty() ? "." : directory));
+    }
+
+    // Started before the first conversion, so that edits made while it runs aren't missed. The files the inputs import
+    // are added as they're found, after the inputs.
+    file_watcher watcher(std::move(inputs));
+    std::vector<std::string> watched_imports;
+    std::vector<std::vector<std::size_t>> importers; // The inputs importing each, directly or not
+
+    auto update = [&](std::size_t i) {
+        const auto& job = jobs[i];
+        auto& file = *files[i];
+        const auto start = std::chrono::steady_clock::now();
+
+        auto source = read_watched_input(job.input);
+        if (!source)
+        {
+            diagnostics << "ERROR: Failed to open file '" << job.input << "'\n";
+            return;
+        }
+        if (!file.update(std::move(source), diagnostics))
+        {
+            diagnostics << "Error encountered while parsing file '" << job.input << "'; keeping the previous output\n";
+            return;
+        }
+
+        for (auto* module : module_graph::reachable(file.imported_modules()))
+        {
+            auto it = std::find(watched_imports.begin(), watched_imports.end(), module->path);
+            if (it == watched_imports.end())
+            {
+                watcher.add(module->path);
+                watched_imports.push_back(module->path);
+                importers.emplace_back();
+                it = watched_imports.end() - 1;
+            }
+            auto& users = importers[static_cast<std::size_t>(it - watched_imports.begin())];
+            if (std::find(users.begin(), users.end(), i) == users.end()) users.push_back(i);
+        }
+
+        std::ostringstream out;
+        write_preamble(job.input, settings.format, out);
+        file.write(out);
+        if (!write_output(job, settings, out.str(), console, diagnostics)) return;
+
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::ostringstream report;
+        report << "Updated " << job.output << " in " << std::fixed << std::setprecision(2) << elapsed.count() << " ms ("
+               << file.reparsed_count() << " of " << file.statement_count() << " statements parsed, "
+               << file.regenerated_count() << " declarations generated)\n";
+        diagnostics << report.str() << std::flush;
+    };
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) update(i);
+    diagnostics << "Watching " << jobs.size() << " file(s) for changes\n" << std::flush;
+
+    std::vector<std::size_t> changed;
+    while (watcher.wait(changed))
+    {
+        // An input is converted again once, whether it or any number of the files it imports changed
+        std::vector<std::size_t> inputs_changed;
+        for (auto i : changed)
+        {
+            if (i < jobs.size()) {
+                inputs_changed.push_back(i);
+            } else {
+                const auto& users = importers[i - jobs.size()];
+                inputs_changed.insert(inputs_changed.end(), users.begin(), users.end());
+            }
+        }
+        std::sort(inputs_changed.begin(), inputs_changed.end());
+        inputs_changed.erase(std::unique(inputs_changed.begin(), inputs_changed.end()), inputs_changed.end());
+        for (auto i : inputs_changed) update(i);
+    }
+
+    diagnostics << "ERROR: Failed to watch input files for changes\n";
+    return false;
+}
+
+/**
+ * @brief Splits the next whitespace-separated, optionally double-quoted, field off the front of 'line'.
+ *
+ * @return False if the line has no more fields or a quote is left unterminated.
+ */
+static bool next_field(std::string_view& line, std::string& field)
+{
+    auto begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) return false;
+    line.remove_prefix(begin);
+
+    if (line.front() == '"')
+    {
+        auto end = line.find('"', 1);
+        if (end == std::string_view::npos) return false;
+        field.assign(line.substr(1, end - 1));
+        line.remove_prefix(end + 1);
+    }
+    else
+    {
+        auto end = line.find_first_of(" \t\r");
+        field.assign(line.substr(0, end));
+        line.remove_prefix((end == std::string_view::npos) ? line.size() : end);
+    }
+    return true;
+}
+
+bool read_manifest(std::istream& input, std::vector<conversion_job>& jobs, std::ostream& diagnostics)
+{
+    bool ok = true;
+    std::string line;
+    for (std::size_t line_number = 1; std::getline(input, line); ++line_number)
+    {
+        std::string_view rest = line;
+        auto first = rest.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos || rest[first] == '#') continue;
+
+        conversion_job job;
+        if (!next_field(rest, job.input) || !next_field(rest, job.output) ||
+            rest.find_first_not_of(" \t\r") != std::string_view::npos)
+        {
+            diagnostics << "ERROR: Manifest line " << line_number << " is not an '<input_file> <output_file>' pair\n";
+            ok = false;
+            continue;
+        }
+        jobs.push_back(std::move(job));
+    }
+    return ok;
+}
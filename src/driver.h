@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.h"
+
+class module_graph;
+class output_cache;
+class run_stats;
+
+/**
+ * @brief A single file to convert and where to write the result.
+ */
+struct conversion_job {
+    std::string input;  /*!< Path of the TypeScript file, or "-" for stdin */
+    std::string output; /*!< Path of the generated file, or "-" for stdout */
+};
+
+/**
+ * @brief One of several outputs generated from the same input.
+ */
+struct output_target {
+    std::string format; /*!< "cpp" or "proto" */
+    std::string path;   /*!< Path of the generated file, or "-" for stdout */
+};
+
+/**
+ * @brief Settings that apply to every file converted in a run; read from the config file once.
+ */
+struct conversion_settings {
+    codegen_config config;
+    std::string format = "cpp";
+
+    // Build each output in memory and leave the existing file untouched if it's unchanged
+    bool write_if_changed = false;
+
+    // Parse each file on a second thread while generating from the declarations already parsed
+    bool pipeline = false;
+
+    // The number of threads each file's C++ declarations are generated on; zero uses one per hardware thread
+    std::size_t generate_threads = 1;
+
+    // Optional; when set, output is reused for inputs that have been converted before with the same settings
+    output_cache* cache = nullptr;
+
+    // Optional; when set, relative imports are loaded through it so that declarations from other files can be used
+    module_graph* modules = nullptr;
+
+    // Optional; when set, each file converted by convert_file is measured and recorded here
+    run_stats* stats = nullptr;
+};
+
+/**
+ * @brief Describes everything in the settings, plus the tool version, that can change the generated output.
+ */
+std::string settings_fingerprint(const conversion_settings& settings);
+
+/**
+ * @brief Parses one input file and writes the generated output for it.
+ *
+ * @param job The input to read and the output to write.
+ * @param settings The output format and code generation config.
+ * @param console Where output is written when the job's output is "-".
+ * @param diagnostics Where errors are reported.
+ * @return True if the output was written, false if the input couldn't be read or parsed or the output couldn't be
+ * opened.
+ */
+bool convert_file(const conversion_job& job, const conversion_settings& settings, std::ostream& console,
+    std::ostream& diagnostics);
+
+/**
+ * @brief Parses one input file once and generates each of the outputs from it, all at the same time.
+ *
+ * Each output is generated in its own format, whatever settings.format is. The output cache and pipelining aren't
+ * used; with settings.stats, the file is recorded once, with the time taken by all of its outputs as generating.
+ *
+ * @param input Path of the TypeScript file, or "-" for stdin.
+ * @param outputs The outputs to generate. Output to "-" is written to 'console' in order once all have finished.
+ * @return True if every output was written.
+ */
+bool convert_file_to_outputs(const std::string& input, const std::vector<output_target>& outputs,
+    const conversion_settings& settings, std::ostream& console, std::ostream& diagnostics);
+
+/**
+ * @brief Writes output generated elsewhere for a job: to 'console' if its output is "-", otherwise by replacing the
+ * file, which is left untouched if it's already up to date and settings.write_if_changed is set.
+ */
+bool write_output(const conversion_job& job, const conversion_settings& settings, const std::string& contents,
+    std::ostream& console, std::ostream& diagnostics);
+
+/**
+ * @brief Converts source text that is already in memory, writing the complete output to 'out'.
+ *
+ * @param name What to call the input in the generated header comment and in errors.
+ * @return False if the text couldn't be parsed.
+ */
+bool convert_text(const std::string& name, std::string_view text, const conversion_settings& settings,
+    std::ostream& out, std::ostream& diagnostics);
+
+/**
+ * @brief Converts one job of a batch, writing its output to 'console' if that is "-", and its errors to 'diagnostics'.
+ *
+ * @return False if the job failed.
+ */
+using job_converter = std::function<bool(const conversion_job& job, std::ostream& console, std::ostream& diagnostics)>;
+
+/**
+ * @brief Runs 'convert' on every job, optionally in parallel, and reports each one as OK or FAILED followed by how
+ * many were converted.
+ *
+ * Each job's console output and diagnostics are buffered and written out in job order once it has finished, so the
+ * result is the same however many threads are used.
+ *
+ * @param thread_count The number of jobs run at once; zero uses one per hardware thread.
+ * @return The number of jobs that failed.
+ */
+std::size_t run_batch(const std::vector<conversion_job>& jobs, std::size_t thread_count, const job_converter& convert,
+    std::ostream& console, std::ostream& diagnostics);
+
+/**
+ * @brief Converts every job with convert_file; see run_batch.
+ *
+ * @param jobs The files to convert. Each should write to a different output.
+ * @param settings The output format and code generation config shared by every job.
+ * @param thread_count The number of files converted at once; zero uses one per hardware thread.
+ * @param console Where output is written for jobs whose output is "-".
+ * @param diagnostics Where errors and the per-file report are written.
+ * @return The number of jobs that failed.
+ */
+std::size_t convert_batch(const std::vector<conversion_job>& jobs, const conversion_settings& settings,
+    std::size_t thread_count, std::ostream& console, std::ostream& diagnostics);
+
+/**
+ * @brief Converts every job, then converts them again whenever their input changes, until the process is stopped.
+ *
+ * Only the declarations affected by an edit are parsed and generated again. An edit that leaves a syntax error is
+ * reported and otherwise ignored, keeping the last good output, until the file is fixed.
+ *
+ * @param jobs The files to convert. Inputs must be files rather than stdin.
+ * @param settings The output format and code generation config shared by every job.
+ * @param console Where output is written for jobs whose output is "-".
+ * @param diagnostics Where errors and a line per update are written.
+ * @return False if the inputs could not be watched.
+ */
+bool watch_files(const std::vector<conversion_job>& jobs, const conversion_settings& settings, std::ostream& console,
+    std::ostream& diagnostics);
+
+/**
+ * @brief Reads a batch manifest: one "<input_file> <output_file>" pair per line.
+ *
+ * Blank lines and lines starting with '#' are skipped. Paths are separated by whitespace, and may be double-quoted
+ * if they contain any.
+ *
+ * @param input The manifest text.
+ * @param jobs Receives one job per pair, in manifest order.
+ * @param diagnostics Where malformed lines are reported.
+ * @return True if every line was well-formed.
+ */
+bool read_manifest(std::istream& input, std::vector<conversion_job>& jobs, std::ostream& diagnostics);
@@ -1,27 +1,225 @@
 #include "codegen_cpp.h"
+#include "symbol_table.h"
+#include "../thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <memory_resource>
 #include <ostream>
 #include <sstream>
 #include <set>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief The C++ spelling of a type expression, along with the headers that spelling needs.
+ *
+ * Everything it refers to is owned by the render_cache it came from.
+ */
+struct rendered_type
+{
+    std::string_view text;
+    const std::string* const* headers = nullptr;
+    std::size_t header_count = 0;
+
+    // Rendered as a placeholder for something C++ can't express; such members and aliases are left out entirely
+    bool is_unsupported = false;
+};
+
+/**
+ * @brief Values attached to AST nodes, looked up by node id rather than hashed.
+ *
+ * Slot indexes are allocated a page of consecutive ids at a time, only for pages holding a node that is given a value,
+ * so a map that only sees part of a file stays small. Values never move once inserted.
+ */
+template <typename T>
+struct node_map
+{
+    explicit node_map(ast::node_id node_count) : pages(page_count(node_count)) {}
+    node_map(const node_map&) = delete;
+    node_map& operator=(const node_map&) = delete;
+
+    T* find(const ast::node* node)
+    {
+        const auto id = key(node);
+        const auto& page = pages[id / page_size];
+        if (!page) return nullptr;
+        auto slot = (*page)[id % page_size];
+        return (slot != 0) ? &entries[slot - 1] : nullptr;
+    }
+
+    T& insert(const ast::node* node)
+    {
+        const auto id = key(node);
+        auto& page = pages[id / page_size];
+        if (!page) page = std::make_unique<page_slots>();
+
+        auto& value = entries.emplace_back();
+        (*page)[id % page_size] = static_cast<std::uint32_t>(entries.size());
+        return value;
+    }
+
+    /**
+     * @brief Makes room for nodes created after the map was, e.g. by a parse that is still running.
+     */
+    void grow(ast::node_id node_count)
+    {
+        if (page_count(node_count) > pages.size()) pages.resize(page_count(node_count));
+    }
+
+private:
+    static constexpr ast::node_id page_size = 4096;
+
+    // Zero for nodes without a value, otherwise one past the value's index in 'entries'
+    using page_slots = std::array<std::uint32_t, page_size>;
+
+    static std::size_t page_count(ast::node_id node_count) noexcept { return (node_count + page_size - 1) / page_size; }
+
+    // A missing node is keyed as node 0, which is always the file itself and so never looked up on its own account
+    static ast::node_id key(const ast::node* node) noexcept { return node ? node->id : 0; }
+
+    std::vector<std::unique_ptr<page_slots>> pages;
+    std::deque<T> entries;
+};
+
+/**
+ * @brief Rendered types by AST node, so that each node is rendered at most once per run.
+ *
+ * Rendering only depends on the node, the config and the symbol table, and the latter two are fixed for a run.
+ */
+struct render_cache
+{
+    explicit render_cache(ast::node_id node_count) : types(node_count) {}
+
+    void grow(ast::node_id node_count) { types.grow(node_count); }
+
+    node_map<rendered_type> types;
+
+    // Storage for the text of every entry
+    std::pmr::monotonic_buffer_resource arena;
+
+    // The handful of distinct headers, shared by every entry that needs them
+    std::set<std::string, std::less<>> header_names;
+};
+
+/**
+ * @brief The members of an interface or alias with those of its bases and intersected types flattened in.
+ */
+struct member_list
+{
+    // Set while the list is being built, so that a declaration which (indirectly) refers to itself is caught
+    bool in_progress = true;
+
+    // False if any part of the declaration isn't an object type that can be flattened
+    bool resolved = false;
+
+    std::vector<ast::member*> members;
+};
 
 struct codegen_state
 {
-    std::stringstream out;
+    // Holds the output of a state created without a destination
+    std::stringstream buffer;
+
+    std::ostream& out;
     const codegen_config& config;
-    std::set<std::string> headers;
-    std::map<std::string, ast::node*> known_nodes;
+    const symbol_table& symbols;
+    render_cache& cache;
+    node_map<member_list>& member_lists;
+    std::set<std::string, std::less<>> headers;
 
-    codegen_state(const codegen_config& conf) : config(conf) {}
+    // Set on the pass that only collects headers, which can skip anything that would only have produced text
+    bool headers_only = false;
 
-    void add_header(const std::string& h)
+    codegen_state(std::ostream& destination, const codegen_config& conf, const symbol_table& symbols,
+        render_cache& cache, node_map<member_list>& member_lists) :
+        out(destination),
+        config(conf),
+        symbols(symbols),
+        cache(cache),
+        member_lists(member_lists)
     {
-        if (!h.empty()) {
-            headers.insert(h);
+    }
+
+    codegen_state(const codegen_config& conf, const symbol_table& symbols, render_cache& cache,
+        node_map<member_list>& member_lists) :
+        codegen_state(buffer, conf, symbols, cache, member_lists)
+    {
+    }
+
+    void add_header(std::string_view h)
+    {
+        // Looked up before inserting, as almost every header has been seen before and then nothing is allocated
+        if (!h.empty() && headers.find(h) == headers.end()) {
+            headers.emplace(h);
+        }
+    }
+
+    /**
+     * @brief Returns an emptied child state for rendering a fragment in isolation, e.g. to inspect a member's type
+     * before deciding whether to emit it. The same child (and its buffer) is reused by every call.
+     */
+    codegen_state& scratch()
+    {
+        if (!scratch_state) {
+            scratch_state = std::make_unique<codegen_state>(config, symbols, cache, member_lists);
+        } else {
+            scratch_state->buffer.str(std::string());
+            scratch_state->buffer.clear();
+            scratch_state->headers.clear();
         }
+        return *scratch_state;
     }
+
+private:
+    std::unique_ptr<codegen_state> scratch_state;
 };
 
 static void generate_type(codegen_state& state, ast::node* type);
 
+/**
+ * @brief Renders a type expression, or returns the result of having done so earlier in the run.
+ */
+static const rendered_type& render_type(codegen_state& state, ast::node* type)
+{
+    auto& cache = state.cache;
+    if (auto* cached = cache.types.find(type)) return *cached;
+
+    auto& temp_state = state.scratch();
+    generate_type(temp_state, type);
+
+    const std::string text = temp_state.buffer.str();
+    auto* text_copy = static_cast<char*>(cache.arena.allocate(text.size(), 1));
+    text.copy(text_copy, text.size());
+
+    // Inserted only now, as rendering may have inserted entries for nested types
+    auto& result = cache.types.insert(type);
+    result.text = std::string_view(text_copy, text.size());
+    result.is_unsupported = (text.find("std::any /*") != std::string::npos) &&
+        (text != "std::any /* unknown */") &&
+        (text != "std::any /* never */");
+
+    if (!temp_state.headers.empty())
+    {
+        auto** headers = static_cast<const std::string**>(
+            cache.arena.allocate(temp_state.headers.size() * sizeof(const std::string*), alignof(const std::string*)));
+        for (const auto& h : temp_state.headers)
+        {
+            headers[result.header_count++] = &*cache.header_names.insert(h).first;
+        }
+        result.headers = headers;
+    }
+    return result;
+}
+
+static void emit_type(codegen_state& state, const rendered_type& type)
+{
+    state.out << type.text;
+    for (std::size_t i = 0; i < type.header_count; ++i) state.add_header(*type.headers[i]);
+}
+
 static void generate_module(codegen_state& state, ast::module* mod)
 {
     state.out << "namespace " << mod->name << " {\n";
@@ -37,26 +235,20 @@ static void generate_object_body(codegen_state& state, ast::object* obj)
     state.out << "{\n";
     for (auto* member : obj->named_members)
     {
-        std::string type_str;
-        codegen_state temp_state(state.config);
-        temp_state.known_nodes = state.known_nodes;
-        generate_type(temp_state, member->type);
-        type_str = temp_state.out.str();
-
-        if (type_str.find("std::any /*") != std::string::npos &&
-            type_str != "std::any /* unknown */" &&
-            type_str != "std::any /* never */") {
+        const auto& type = render_type(state, member->type);
+        if (type.is_unsupported) {
             continue;
         }
 
         state.out << "    ";
         if (member->is_optional) {
             state.add_header("#include <optional>");
-            state.out << "std::optional<" << type_str << ">";
+            state.out << "std::optional<";
+            emit_type(state, type);
+            state.out << ">";
         } else {
-            state.out << type_str;
+            emit_type(state, type);
         }
-        for (const auto& h : temp_state.headers) state.add_header(h);
         state.out << " " << member->name << ";\n";
     }
     state.out << "}";
@@ -87,40 +279,91 @@ static void generate_interface(codegen_state& state, ast::interface* iface)
     }
 }
 
+static bool collect_members(codegen_state& state, ast::node* type, std::vector<ast::member*>& members);
+
+/**
+ * @brief Flattens the members of a named declaration, once per run.
+ *
+ * @return The flattened members, or nullptr if the declaration can't be flattened or refers back to itself.
+ */
+static const std::vector<ast::member*>* flatten_declaration(codegen_state& state, ast::node* decl)
+{
+    if (auto* list = state.member_lists.find(decl))
+    {
+        return (list->resolved && !list->in_progress) ? &list->members : nullptr;
+    }
+
+    auto& list = state.member_lists.insert(decl);
+    std::vector<ast::member*> members;
+    if (decl->kind == ast::node_kind::interface)
+    {
+        auto* iface = static_cast<ast::interface*>(decl);
+        list.resolved = true;
+        for (auto* b : iface->base) {
+            if (!collect_members(state, b, members)) {
+                list.resolved = false;
+                break;
+            }
+        }
+        if (list.resolved && iface->definition) {
+            members.insert(members.end(), iface->definition->named_members.begin(), iface->definition->named_members.end());
+        }
+    }
+    else
+    {
+        list.resolved = collect_members(state, static_cast<ast::type_alias*>(decl)->target_type, members);
+    }
+
+    list.in_progress = false;
+    if (list.resolved) list.members = std::move(members);
+    return list.resolved ? &list.members : nullptr;
+}
+
+/**
+ * @brief Appends the members of an object-like type to 'members'.
+ *
+ * @return False if the type (or anything it's built from) isn't an object type that can be flattened.
+ */
 static bool collect_members(codegen_state& state, ast::node* type, std::vector<ast::member*>& members)
 {
     if (!type) return false;
-    if (auto* gref = dynamic_cast<ast::generic_type_reference*>(type)) {
-        auto it = state.known_nodes.find(gref->name);
-        if (it != state.known_nodes.end()) {
-            return collect_members(state, it->second, members);
+    switch (type->kind)
+    {
+    case ast::node_kind::generic_type_reference: {
+        if (auto* known = state.symbols.find(static_cast<ast::generic_type_reference*>(type)->name_id)) {
+            return collect_members(state, known, members);
         }
         return false;
-    } else if (auto* iface = dynamic_cast<ast::interface*>(type)) {
-        for (auto* b : iface->base) {
-            if (!collect_members(state, b, members)) return false;
-        }
-        if (iface->definition) {
-            for (auto* m : iface->definition->named_members) members.push_back(m);
+    }
+    case ast::node_kind::interface_reference: {
+        if (auto* known = state.symbols.find(static_cast<ast::interface_reference*>(type)->name_id)) {
+            return collect_members(state, known, members);
         }
+        return false;
+    }
+    case ast::node_kind::interface:
+    case ast::node_kind::type_alias: {
+        auto* flattened = flatten_declaration(state, type);
+        if (!flattened) return false;
+        members.insert(members.end(), flattened->begin(), flattened->end());
         return true;
-    } else if (auto* alias = dynamic_cast<ast::type_alias*>(type)) {
-        return collect_members(state, alias->target_type, members);
-    } else if (auto* obj = dynamic_cast<ast::object*>(type)) {
-        for (auto* m : obj->named_members) members.push_back(m);
+    }
+    case ast::node_kind::object:
+        for (auto* m : static_cast<ast::object*>(type)->named_members) members.push_back(m);
         return true;
-    } else if (auto* in = dynamic_cast<ast::intersection_type*>(type)) {
-        for (auto* t : in->types) {
+    case ast::node_kind::intersection_type:
+        for (auto* t : static_cast<ast::intersection_type*>(type)->types) {
             if (!collect_members(state, t, members)) return false;
         }
         return true;
+    default:
+        return false;
     }
-    return false;
 }
 
-static std::string make_identifier(const std::string& str) {
+static std::string make_identifier(std::string_view str) {
     if (str.empty()) return "_";
-    std::string res = str;
+    std::string res(str);
     for (char& c : res) {
         if (!std::isalnum(c)) c = '_';
     }
@@ -128,30 +371,39 @@ static std::string make_identifier(const std::string& str) {
     return res;
 }
 
-static bool is_literal_union_or_single(codegen_state& state, ast::node* node, std::vector<std::string>& values) {
+/**
+ * @brief Collects the string values of a union of literals, following aliases and enums it names.
+ *
+ * @param expanding The aliases being followed on the way here; one that names itself again is a cycle, not a union.
+ */
+static bool is_literal_union_or_single(codegen_state& state, ast::node* node, std::vector<std::string>& values,
+    std::vector<const ast::type_alias*>& expanding) {
     if (!node) return false;
-    if (auto* lit = dynamic_cast<ast::literal_type*>(node)) {
-        values.push_back(lit->value);
+    switch (node->kind)
+    {
+    case ast::node_kind::literal_type:
+        values.emplace_back(static_cast<ast::literal_type*>(node)->value);
         return true;
-    } else if (auto* un = dynamic_cast<ast::union_type*>(node)) {
-        for (auto* t : un->types) {
-            if (!is_literal_union_or_single(state, t, values)) return false;
+    case ast::node_kind::union_type:
+        for (auto* t : static_cast<ast::union_type*>(node)->types) {
+            if (!is_literal_union_or_single(state, t, values, expanding)) return false;
         }
         return true;
-    } else if (auto* gref = dynamic_cast<ast::generic_type_reference*>(node)) {
-        if (gref->name == "Capitalize" || gref->name == "Uncapitalize" || gref->name == "Uppercase" || gref->name == "Lowercase") {
+    case ast::node_kind::generic_type_reference: {
+        auto* gref = static_cast<ast::generic_type_reference*>(node);
+        if (gref->name_id == ast::builtin::Capitalize || gref->name_id == ast::builtin::Uncapitalize || gref->name_id == ast::builtin::Uppercase || gref->name_id == ast::builtin::Lowercase) {
             if (!gref->arguments.empty()) {
                 std::vector<std::string> base_vals;
-                if (is_literal_union_or_single(state, gref->arguments[0], base_vals)) {
+                if (is_literal_union_or_single(state, gref->arguments[0], base_vals, expanding)) {
                     for (auto& v : base_vals) {
                         if (v.empty()) continue;
-                        if (gref->name == "Capitalize") {
+                        if (gref->name_id == ast::builtin::Capitalize) {
                             v[0] = std::toupper(v[0]);
-                        } else if (gref->name == "Uncapitalize") {
+                        } else if (gref->name_id == ast::builtin::Uncapitalize) {
                             v[0] = std::tolower(v[0]);
-                        } else if (gref->name == "Uppercase") {
+                        } else if (gref->name_id == ast::builtin::Uppercase) {
                             for (char& c : v) c = std::toupper(c);
-                        } else if (gref->name == "Lowercase") {
+                        } else if (gref->name_id == ast::builtin::Lowercase) {
                             for (char& c : v) c = std::tolower(c);
                         }
                         values.push_back(v);
@@ -159,28 +411,30 @@ static bool is_literal_union_or_single(codegen_state& state, ast::node* node, st
                     return true;
                 }
             }
-        } else if (gref->name == "Exclude" || gref->name == "Extract") {
+        } else if (gref->name_id == ast::builtin::Exclude || gref->name_id == ast::builtin::Extract) {
             if (gref->arguments.size() >= 2) {
                 std::vector<std::string> base_vals, filter_vals;
-                if (is_literal_union_or_single(state, gref->arguments[0], base_vals) && is_literal_union_or_single(state, gref->arguments[1], filter_vals)) {
+                if (is_literal_union_or_single(state, gref->arguments[0], base_vals, expanding) && is_literal_union_or_single(state, gref->arguments[1], filter_vals, expanding)) {
                     std::set<std::string> filter_set(filter_vals.begin(), filter_vals.end());
                     for (auto& v : base_vals) {
                         bool present = filter_set.count(v);
-                        if (gref->name == "Exclude" && !present) values.push_back(v);
-                        if (gref->name == "Extract" && present) values.push_back(v);
+                        if (gref->name_id == ast::builtin::Exclude && !present) values.push_back(v);
+                        if (gref->name_id == ast::builtin::Extract && present) values.push_back(v);
                     }
                     return true;
                 }
             }
         } else {
-            auto it = state.known_nodes.find(gref->name);
-            if (it != state.known_nodes.end()) {
-                if (auto* alias = dynamic_cast<ast::type_alias*>(it->second)) {
-                    return is_literal_union_or_single(state, alias->target_type, values);
-                } else if (auto* en = dynamic_cast<ast::enumeration*>(it->second)) {
+            if (auto* known = state.symbols.find(gref->name_id)) {
+                if (auto* alias = ast::node_cast<ast::type_alias>(known)) {
+                    if (std::find(expanding.begin(), expanding.end(), alias) != expanding.end()) return false;
+                    expanding.push_back(alias);
+                    const bool is_union = is_literal_union_or_single(state, alias->target_type, values, expanding);
+                    expanding.pop_back();
+                    return is_union;
+                } else if (auto* en = ast::node_cast<ast::enumeration>(known)) {
                     for (auto& m : en->members) {
-                        std::string val = m.value;
-                        if (val.empty()) val = m.name;
+                        std::string val(m.value.empty() ? m.name : m.value);
                         if (val.size() >= 2 && val.front() == '"' && val.back() == '"') {
                             val = val.substr(1, val.size() - 2);
                         }
@@ -190,31 +444,31 @@ static bool is_literal_union_or_single(codegen_state& state, ast::node* node, st
                 }
             }
         }
+        return false;
     }
-    return false;
+    default:
+        return false;
+    }
+}
+
+static bool is_literal_union_or_single(codegen_state& state, ast::node* node, std::vector<std::string>& values) {
+    std::vector<const ast::type_alias*> expanding;
+    return is_literal_union_or_single(state, node, values, expanding);
 }
 
 static void generate_type_alias(codegen_state& state, ast::type_alias* alias)
 {
-    if (auto* in = dynamic_cast<ast::intersection_type*>(alias->target_type)) {
-        std::vector<ast::member*> members;
-        bool all_known = true;
-        for (auto* t : in->types) {
-            if (!collect_members(state, t, members)) {
-                all_known = false;
-                break;
-            }
-        }
-        if (all_known) {
+    if (alias->target_type && alias->target_type->kind == ast::node_kind::intersection_type) {
+        if (auto* members = flatten_declaration(state, alias)) {
             state.out << "struct " << alias->name << "\n{\n";
-            for (auto* member : members)
+            for (auto* member : *members)
             {
                 state.out << "    ";
                 if (member->is_optional) {
                     state.add_header("#include <optional>");
                     state.out << "std::optional<";
                 }
-                generate_type(state, member->type);
+                emit_type(state, render_type(state, member->type));
                 if (member->is_optional) state.out << ">";
                 state.out << " " << member->name << ";\n";
             }
@@ -223,13 +477,13 @@ static void generate_type_alias(codegen_state& state, ast::type_alias* alias)
         return;
     }
 
-    if (auto* gref = dynamic_cast<ast::generic_type_reference*>(alias->target_type)) {
-        if (gref->name == "Partial" || gref->name == "Readonly" || gref->name == "Omit" || gref->name == "Pick" || gref->name == "NonNullable") {
+    if (auto* gref = ast::node_cast<ast::generic_type_reference>(alias->target_type)) {
+        if (gref->name_id == ast::builtin::Partial || gref->name_id == ast::builtin::Readonly || gref->name_id == ast::builtin::Omit || gref->name_id == ast::builtin::Pick || gref->name_id == ast::builtin::NonNullable) {
             if (!gref->arguments.empty()) {
                 std::vector<ast::member*> members;
                 if (collect_members(state, gref->arguments[0], members)) {
-                    std::set<std::string> omitted;
-                    if ((gref->name == "Omit" || gref->name == "Pick") && gref->arguments.size() > 1) {
+                    std::set<std::string, std::less<>> omitted;
+                    if ((gref->name_id == ast::builtin::Omit || gref->name_id == ast::builtin::Pick) && gref->arguments.size() > 1) {
                         std::vector<std::string> omit_keys;
                         is_literal_union_or_single(state, gref->arguments[1], omit_keys);
                         for (const auto& k : omit_keys) {
@@ -241,21 +495,21 @@ static void generate_type_alias(codegen_state& state, ast::type_alias* alias)
 
                     state.out << "struct " << alias->name << "\n{\n";
                     for (auto* m : members) {
-                        if (gref->name == "Omit" && omitted.count(m->name)) continue;
-                        if (gref->name == "Pick" && !omitted.count(m->name)) continue;
+                        if (gref->name_id == ast::builtin::Omit && omitted.count(m->name)) continue;
+                        if (gref->name_id == ast::builtin::Pick && !omitted.count(m->name)) continue;
 
                         state.out << "    ";
                         bool is_opt = m->is_optional;
-                        if (gref->name == "Partial") is_opt = true;
+                        if (gref->name_id == ast::builtin::Partial) is_opt = true;
 
-                        if (gref->name == "Readonly") state.out << "const ";
+                        if (gref->name_id == ast::builtin::Readonly) state.out << "const ";
 
                         if (is_opt) {
                             state.add_header("#include <optional>");
                             state.out << "std::optional<";
                         }
 
-                        generate_type(state, m->type);
+                        emit_type(state, render_type(state, m->type));
 
                         if (is_opt) state.out << ">";
 
@@ -270,6 +524,7 @@ static void generate_type_alias(codegen_state& state, ast::type_alias* alias)
 
     std::vector<std::string> literal_values;
     if (is_literal_union_or_single(state, alias->target_type, literal_values)) {
+        if (state.headers_only) return;
         state.out << "enum class " << alias->name << " {\n";
         for (const auto& val : literal_values) {
             state.out << "    " << make_identifier(val) << ",\n";
@@ -285,32 +540,26 @@ static void generate_type_alias(codegen_state& state, ast::type_alias* alias)
         return;
     }
 
-    if (auto* obj = dynamic_cast<ast::object*>(alias->target_type)) {
+    if (auto* obj = ast::node_cast<ast::object>(alias->target_type)) {
         state.out << "struct " << alias->name << "\n";
         generate_object_body(state, obj);
         state.out << ";\n\n";
         return;
     }
 
-    std::string type_str;
-    {
-        codegen_state temp_state(state.config);
-        temp_state.known_nodes = state.known_nodes;
-        generate_type(temp_state, alias->target_type);
-        type_str = temp_state.out.str();
-
-        if (type_str.find("std::any /*") != std::string::npos &&
-            type_str != "std::any /* unknown */" &&
-            type_str != "std::any /* never */") {
-            return;
-        }
-        for (const auto& h : temp_state.headers) state.add_header(h);
+    const auto& type = render_type(state, alias->target_type);
+    if (type.is_unsupported) {
+        return;
     }
-    state.out << "using " << alias->name << " = " << type_str << ";\n\n";
+    state.out << "using " << alias->name << " = ";
+    emit_type(state, type);
+    state.out << ";\n\n";
 }
 
 static void generate_enum(codegen_state& state, ast::enumeration* en)
 {
+    if (state.headers_only) return;
+
     state.out << "enum class " << en->name << " {\n";
     for (const auto& member : en->members)
     {
@@ -322,22 +571,20 @@ static void generate_enum(codegen_state& state, ast::enumeration* en)
     if (state.config.cpp.enum_mode == enum_generation_mode::with_array) {
         state.out << "constexpr const char* " << en->name << "Strings[] = {\n";
         for (const auto& member : en->members) {
-            std::string val = member.value;
-            if (val.empty()) val = member.name;
-            else if (val.size() >= 2 && val.front() == '"' && val.back() == '"') val = val.substr(1, val.size() - 2);
+            std::string val(member.value.empty() ? member.name : member.value);
+            if (!member.value.empty() && val.size() >= 2 && val.front() == '"' && val.back() == '"') val = val.substr(1, val.size() - 2);
             state.out << "    \"" << val << "\",\n";
         }
         state.out << "};\n\n";
     }
 }
 
-static void check_config(codegen_state& state, const std::string& type_name, const std::string& fallback, const std::string& fallback_header = "")
+static void check_config(codegen_state& state, ast::symbol_id type_name, std::string_view fallback, std::string_view fallback_header = {})
 {
-    auto it = state.config.datatypes.find(type_name);
-    if (it != state.config.datatypes.end())
+    if (auto* dt = state.symbols.datatype(type_name))
     {
-        state.out << it->second.out;
-        state.add_header(it->second.header);
+        state.out << dt->out;
+        state.add_header(dt->header);
     }
     else
     {
@@ -348,186 +595,500 @@ static void check_config(codegen_state& state, const std::string& type_name, con
 
 static void generate_import(codegen_state& state, ast::import_stmt* imp)
 {
-    state.add_header("#include \"" + imp->module_name + ".h\"");
+    state.add_header("#include \"" + std::string(imp->module_name) + ".h\"");
 }
 
-static void generate_type(codegen_state& state, ast::node* type)
+static void generate_generic_reference(codegen_state& state, ast::generic_type_reference* gref)
 {
-    if (!type) { check_config(state, "any", "std::any", "#include <any>"); return; }
-
-    if (auto* mod = dynamic_cast<ast::module*>(type))
-    {
-        generate_module(state, mod);
-    }
-    else if (auto* imp = dynamic_cast<ast::import_stmt*>(type))
-    {
-        generate_import(state, imp);
-    }
-    else if (auto* iface = dynamic_cast<ast::interface*>(type))
-    {
-        generate_interface(state, iface);
-    }
-    else if (auto* alias = dynamic_cast<ast::type_alias*>(type))
-    {
-        generate_type_alias(state, alias);
-    }
-    else if (auto* en = dynamic_cast<ast::enumeration*>(type))
-    {
-        generate_enum(state, en);
+    if (gref->name_id == ast::builtin::undefined) {
+        state.add_header("#include <variant>");
+        state.out << "std::monostate";
+        return;
+    } else if (gref->name_id == ast::builtin::Array || gref->name_id == ast::builtin::ReadonlyArray) {
+        state.add_header("#include <vector>");
+        state.out << "std::vector<";
+        if (!gref->arguments.empty()) generate_type(state, gref->arguments[0]);
+        else state.out << "std::any";
+        state.out << ">";
+    } else if (gref->name_id == ast::builtin::Record) {
+        state.add_header("#include <map>");
+        state.out << "std::map<";
+        if (gref->arguments.size() >= 1) generate_type(state, gref->arguments[0]); else state.out << "std::string";
+        state.out << ", ";
+        if (gref->arguments.size() >= 2) generate_type(state, gref->arguments[1]); else state.out << "std::any";
+        state.out << ">";
+    } else if (gref->name_id == ast::builtin::NonNullable) {
+        if (!gref->arguments.empty()) generate_type(state, gref->arguments[0]);
+        else {
+             state.add_header("#include <any>");
+             state.out << "std::any /* NonNullable */";
+        }
+    } else if (gref->name_id == ast::builtin::Partial || gref->name_id == ast::builtin::Readonly || gref->name_id == ast::builtin::Omit || gref->name_id == ast::builtin::Pick || gref->name_id == ast::builtin::Capitalize || gref->name_id == ast::builtin::Uncapitalize || gref->name_id == ast::builtin::Uppercase || gref->name_id == ast::builtin::Lowercase || gref->name_id == ast::builtin::Exclude || gref->name_id == ast::builtin::Extract || gref->name_id == ast::builtin::type_query) {
+        // Fallback for unresolved utility types
+        state.add_header("#include <any>");
+        state.out << "std::any /* " << gref->name << " */";
+    } else {
+        check_config(state, gref->name_id, gref->name, "");
+        if (!gref->arguments.empty()) {
+            state.out << "<";
+            for (size_t i = 0; i < gref->arguments.size(); ++i) {
+                if (i > 0) state.out << ", ";
+                generate_type(state, gref->arguments[i]);
+            }
+            state.out << ">";
+        }
     }
-    else if (auto* ref = dynamic_cast<ast::interface_reference*>(type))
+}
+
+static void generate_fundamental(codegen_state& state, ast::fundamental_type_reference* f)
+{
+    switch (f->type)
     {
-        check_config(state, ref->name, ref->name, "");
+    case ast::fundamental_type::any: check_config(state, ast::builtin::any, "std::any", "#include <any>"); break;
+    case ast::fundamental_type::boolean: check_config(state, ast::builtin::boolean, "bool"); break;
+    case ast::fundamental_type::number: check_config(state, ast::builtin::number, "double"); break;
+    case ast::fundamental_type::string: check_config(state, ast::builtin::string, "std::string", "#include <string>"); break;
+    case ast::fundamental_type::unknown: check_config(state, ast::builtin::unknown, "std::any /* unknown */", "#include <any>"); break;
+    case ast::fundamental_type::never: check_config(state, ast::builtin::never, "std::any /* never */", "#include <any>"); break;
     }
-    else if (auto* gref = dynamic_cast<ast::generic_type_reference*>(type))
-    {
-        if (gref->name == "undefined") {
-            state.add_header("#include <variant>");
-            state.out << "std::monostate";
-            return;
-        } else if (gref->name == "Array" || gref->name == "ReadonlyArray") {
-            state.add_header("#include <vector>");
-            state.out << "std::vector<";
-            if (!gref->arguments.empty()) generate_type(state, gref->arguments[0]);
-            else state.out << "std::any";
-            state.out << ">";
-        } else if (gref->name == "Record") {
-            state.add_header("#include <map>");
-            state.out << "std::map<";
-            if (gref->arguments.size() >= 1) generate_type(state, gref->arguments[0]); else state.out << "std::string";
-            state.out << ", ";
-            if (gref->arguments.size() >= 2) generate_type(state, gref->arguments[1]); else state.out << "std::any";
-            state.out << ">";
-        } else if (gref->name == "NonNullable") {
-            if (!gref->arguments.empty()) generate_type(state, gref->arguments[0]);
-            else {
-                 state.add_header("#include <any>");
-                 state.out << "std::any /* NonNullable */";
-            }
-        } else if (gref->name == "Partial" || gref->name == "Readonly" || gref->name == "Omit" || gref->name == "Pick" || gref->name == "Capitalize" || gref->name == "Uncapitalize" || gref->name == "Uppercase" || gref->name == "Lowercase" || gref->name == "Exclude" || gref->name == "Extract") {
-            // Fallback for unresolved utility types
-            state.add_header("#include <any>");
-            state.out << "std::any /* " << gref->name << " */";
-        } else {
-            check_config(state, gref->name, gref->name, "");
-            if (!gref->arguments.empty()) {
-                state.out << "<";
-                for (size_t i = 0; i < gref->arguments.size(); ++i) {
-                    if (i > 0) state.out << ", ";
-                    generate_type(state, gref->arguments[i]);
-                }
-                state.out << ">";
-            }
-        }
+}
+
+static void generate_literal(codegen_state& state, ast::literal_type* lit)
+{
+    if (lit->is_string) {
+        check_config(state, ast::builtin::string, "std::string", "#include <string>");
+        state.out << " /* " << lit->value << " */";
+    } else if (lit->is_number) {
+        check_config(state, ast::builtin::number, "double");
+        state.out << " /* " << lit->value << " */";
+    } else {
+        check_config(state, ast::builtin::any, "std::any", "#include <any>");
+        state.out << " /* literal */";
     }
-    else if (auto* f = dynamic_cast<ast::fundamental_type_reference*>(type))
+}
+
+static void generate_type_list(codegen_state& state, const char* open, const ast::list<ast::node*>& types)
+{
+    state.out << open;
+    for (size_t i = 0; i < types.size(); ++i)
     {
-        switch (f->type)
-        {
-        case ast::fundamental_type::any: check_config(state, "any", "std::any", "#include <any>"); break;
-        case ast::fundamental_type::boolean: check_config(state, "boolean", "bool"); break;
-        case ast::fundamental_type::number: check_config(state, "number", "double"); break;
-        case ast::fundamental_type::string: check_config(state, "string", "std::string", "#include <string>"); break;
-        case ast::fundamental_type::unknown: check_config(state, "unknown", "std::any /* unknown */", "#include <any>"); break;
-        case ast::fundamental_type::never: check_config(state, "never", "std::any /* never */", "#include <any>"); break;
-        }
+        if (i > 0) state.out << ", ";
+        generate_type(state, types[i]);
     }
-    else if (auto* arr = dynamic_cast<ast::array*>(type))
+    state.out << ">";
+}
+
+/**
+ * @brief Node visitor that emits the C++ for a declaration or type expression.
+ */
+struct type_generator
+{
+    codegen_state& state;
+
+    void operator()(ast::module* mod) { generate_module(state, mod); }
+    void operator()(ast::import_stmt* imp) { generate_import(state, imp); }
+    void operator()(ast::interface* iface) { generate_interface(state, iface); }
+    void operator()(ast::type_alias* alias) { generate_type_alias(state, alias); }
+    void operator()(ast::enumeration* en) { generate_enum(state, en); }
+    void operator()(ast::interface_reference* ref) { check_config(state, ref->name_id, ref->name, ""); }
+    void operator()(ast::generic_type_reference* gref) { generate_generic_reference(state, gref); }
+    void operator()(ast::fundamental_type_reference* f) { generate_fundamental(state, f); }
+    void operator()(ast::literal_type* lit) { generate_literal(state, lit); }
+
+    void operator()(ast::array* arr)
     {
         state.add_header("#include <vector>");
         state.out << "std::vector<";
         generate_type(state, arr->type);
         state.out << ">";
     }
-    else if (auto* un = dynamic_cast<ast::union_type*>(type))
+
+    void operator()(ast::union_type* un)
     {
         state.add_header("#include <variant>");
-        state.out << "std::variant<";
-        for (size_t i = 0; i < un->types.size(); ++i)
-        {
-            if (i > 0) state.out << ", ";
-            generate_type(state, un->types[i]);
-        }
-        state.out << ">";
+        generate_type_list(state, "std::variant<", un->types);
     }
-    else if (auto* in = dynamic_cast<ast::intersection_type*>(type))
+
+    void operator()(ast::intersection_type*)
     {
         // Intersections inline that are unknown or have no name output nothing or std::any.
         // Handled completely in type_aliases if named.
         state.add_header("#include <any>");
         state.out << "std::any /* inline intersection */";
     }
-    else if (auto* tup = dynamic_cast<ast::tuple_type*>(type))
+
+    void operator()(ast::tuple_type* tup)
     {
         state.add_header("#include <tuple>");
-        state.out << "std::tuple<";
-        for (size_t i = 0; i < tup->elements.size(); ++i)
-        {
-            if (i > 0) state.out << ", ";
-            generate_type(state, tup->elements[i]);
-        }
-        state.out << ">";
-    }
-    else if (auto* lit = dynamic_cast<ast::literal_type*>(type))
-    {
-        if (lit->is_string) {
-            check_config(state, "string", "std::string", "#include <string>");
-            state.out << " /* " << lit->value << " */";
-        } else if (lit->is_number) {
-            check_config(state, "number", "double");
-            state.out << " /* " << lit->value << " */";
-        } else {
-            check_config(state, "any", "std::any", "#include <any>");
-            state.out << " /* literal */";
-        }
+        generate_type_list(state, "std::tuple<", tup->elements);
     }
-    else if (auto* obj = dynamic_cast<ast::object*>(type))
+
+    void operator()(ast::object*)
     {
         state.add_header("#include <map>");
         state.add_header("#include <string>");
         state.add_header("#include <any>");
         state.out << "std::map<std::string, std::any> /* object */";
     }
-    else if (auto* ct = dynamic_cast<ast::conditional_type*>(type))
+
+    void operator()(ast::conditional_type*)
     {
         state.add_header("#include <any>");
         state.out << "std::any /* conditional */";
     }
-    else
+
+    template <typename T>
+    void operator()(T*)
     {
         state.add_header("#include <any>");
         state.out << "std::any /* unmapped type */";
     }
+};
+
+static void generate_type(codegen_state& state, ast::node* type)
+{
+    if (!type) { check_config(state, ast::builtin::any, "std::any", "#include <any>"); return; }
+
+    ast::visit(type, type_generator{ state });
+}
+
+/**
+ * @brief Writes a complete header: the preamble, the includes and then the generated declarations.
+ */
+template <typename Func>
+static void write_header(std::ostream& out, const std::set<std::string, std::less<>>& headers, Func&& write_body)
+{
+    out << "// Auto-generated by ts-type-conv\n"
+        << "#pragma once\n\n";
+
+    for (const auto& h : headers)
+    {
+        out << h << "\n";
+    }
+    if (!headers.empty()) out << "\n";
+
+    write_body(out);
+}
+
+/**
+ * @brief What generating a whole file in two passes keeps between them.
+ *
+ * The includes come before the declarations that need them, so the first pass generates every declaration only to
+ * collect its headers, discarding the text. That also renders every type and flattens every declaration into the
+ * caches, leaving the second pass, which writes straight to the destination, little to do but copy cached text. The
+ * output is never held in memory as a whole.
+ */
+struct two_pass_generation
+{
+    two_pass_generation(const ast::file* file, const codegen_config& config) :
+        config(config),
+        symbols(file, config),
+        cache(file->node_count()),
+        member_lists(file->node_count()),
+        discard(nullptr),
+        first_pass(discard, config, symbols, cache, member_lists)
+    {
+        first_pass.headers_only = true;
+    }
+
+    void grow(ast::node_id node_count)
+    {
+        cache.grow(node_count);
+        member_lists.grow(node_count);
+    }
+
+    void write(std::ostream& out, const ast::file* file)
+    {
+        write_header(out, first_pass.headers, [&](std::ostream& o) {
+            codegen_state second_pass(o, config, symbols, cache, member_lists);
+            for (auto* child : file->children)
+            {
+                generate_type(second_pass, child);
+            }
+        });
+    }
+
+    const codegen_config& config;
+    symbol_table symbols;
+    render_cache cache;
+    node_map<member_list> member_lists;
+
+    // Has no buffer, so it's always in a failed state and everything written to it is dropped before being formatted
+    std::ostream discard;
+    codegen_state first_pass;
+};
+
+/**
+ * @brief The output for a run of consecutive top-level declarations, generated on a worker thread.
+ */
+struct generated_chunk
+{
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    std::string text;
+    std::set<std::string, std::less<>> headers;
+};
+
+/**
+ * @brief Generates runs of declarations on a thread pool, each into its own buffer, then writes the merged headers and
+ * the buffers in source order.
+ *
+ * Nothing a declaration generates to depends on what was generated before it, so each worker has its own caches, and
+ * only reads the symbol table they share. The output is exactly that of the serial generator, but is held in memory
+ * until every run has finished.
+ */
+static void generate_cpp_parallel(std::ostream& out, ast::file* file, const codegen_config& config,
+    std::size_t thread_count)
+{
+    work_stealing_pool pool(thread_count);
+    const symbol_table symbols(file, config);
+
+    // Several runs per worker, so that one that's slow to generate doesn't leave the others idle at the end
+    const std::size_t count = file->children.size();
+    const std::size_t chunk_count = std::min(count, pool.size() * 8);
+    std::vector<generated_chunk> chunks(chunk_count);
+    for (std::size_t i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].begin = count * i / chunk_count;
+        chunks[i].end = count * (i + 1) / chunk_count;
+    }
+
+    // Taken in order, so that each worker's caches mostly hold the declarations near the ones it's generating
+    std::atomic<std::size_t> next_chunk{ 0 };
+    for (std::size_t worker = 0; worker < pool.size(); ++worker)
+    {
+        pool.submit([&] {
+            render_cache cache(file->node_count());
+            node_map<member_list> member_lists(file->node_count());
+            codegen_state state(config, symbols, cache, member_lists);
+
+            for (auto i = next_chunk++; i < chunk_count; i = next_chunk++)
+            {
+                auto& chunk = chunks[i];
+                state.buffer.str(std::string());
+                state.buffer.clear();
+                for (std::size_t child = chunk.begin; child < chunk.end; ++child)
+                {
+                    generate_type(state, file->children[child]);
+                }
+                chunk.text = state.buffer.str();
+                chunk.headers = std::move(state.headers);
+                state.headers.clear();
+            }
+        });
+    }
+    pool.wait();
+
+    std::set<std::string, std::less<>> headers;
+    for (auto& chunk : chunks) headers.merge(chunk.headers);
+    write_header(out, headers, [&](std::ostream& o) {
+        for (const auto& chunk : chunks) o << chunk.text;
+    });
 }
 
-void generate_cpp(std::ostream& out, ast::file* file, const codegen_config& config)
+void generate_cpp(std::ostream& out, ast::file* file, const codegen_config& config, std::size_t thread_count)
 {
-    codegen_state state(config);
+    if (thread_count != 1 && file->children.size() > 1)
+    {
+        generate_cpp_parallel(out, file, config, thread_count);
+        return;
+    }
 
+    two_pass_generation generation(file, config);
     for (auto* child : file->children)
     {
-        if (auto* iface = dynamic_cast<ast::interface*>(child)) {
-            state.known_nodes[iface->name] = iface;
-        } else if (auto* alias = dynamic_cast<ast::type_alias*>(child)) {
-            state.known_nodes[alias->name] = alias;
-        } else if (auto* en = dynamic_cast<ast::enumeration*>(child)) {
-            state.known_nodes[en->name] = en;
+        generate_type(generation.first_pass, child);
+    }
+    generation.write(out, file);
+}
+
+/**
+ * @brief Interns the names that the config has datatype overrides for, so that they get ids before parsing starts.
+ */
+static void intern_datatype_names(ast::file* file, const codegen_config& config)
+{
+    for (const auto& [name, entry] : config.datatypes) file->symbols.intern(name);
+}
+
+struct cpp_pipeline_generator::state
+{
+    state(ast::file* file, const codegen_config& config) :
+        file(file),
+        config(config),
+        generation(std::make_unique<two_pass_generation>(file, config))
+    {
+    }
+
+    enum class progress : std::uint8_t
+    {
+        unknown,
+        checking,  // On the path being checked, so one that leads back to it is a cycle rather than a missing name
+        declared,  // Every name it refers to, directly or through other declarations, is declared
+        generated, // Declared, and the first pass has been run on it
+    };
+
+    /**
+     * @brief Checks that everything 'decl' refers to has been declared, following names into their declarations.
+     *
+     * @param missing Receives a name that hasn't been declared yet, if any.
+     * @param visited Receives every declaration that was checked.
+     */
+    bool references_declared(ast::node* decl, ast::symbol_id& missing, std::vector<ast::node*>& visited)
+    {
+        if (declarations[decl->id] != progress::unknown) return true;
+        declarations[decl->id] = progress::checking;
+        visited.push_back(decl);
+
+        std::vector<ast::symbol_id> references;
+        ast::collect_references(decl, references);
+        for (auto id : references)
+        {
+            // Builtins need no declaration; one that is given one anyway is caught by finish()
+            if (id < ast::builtin::count) continue;
+
+            auto* target = generation->symbols.find(id);
+            if (!target)
+            {
+                missing = id;
+                return false;
+            }
+            if (!references_declared(target, missing, visited)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Runs the first pass on a declaration if it can be, or else leaves it waiting for the name it's missing.
+     */
+    void try_generate(ast::node* decl)
+    {
+        std::vector<ast::node*> visited;
+        ast::symbol_id missing = ast::invalid_symbol;
+        const bool ready = references_declared(decl, missing, visited);
+        for (auto* checked : visited) declarations[checked->id] = ready ? progress::declared : progress::unknown;
+
+        if (!ready)
+        {
+            waiting[missing].push_back(decl);
+            return;
         }
+        generate_type(generation->first_pass, decl);
+        declarations[decl->id] = progress::generated;
     }
 
+    /**
+     * @brief Whether a name that a declaration may have been generated with has come to mean something else.
+     *
+     * Declarations only wait for names that haven't been declared at all, so this happens when a name is declared
+     * again, or when the file or an import declares a builtin's name.
+     */
+    bool rebound(const symbol_table& final_symbols) const
+    {
+        if (redeclared) return true;
+        for (ast::symbol_id id = 0; id < ast::builtin::count; ++id)
+        {
+            if (final_symbols.find(id)) return true;
+        }
+        return false;
+    }
+
+    ast::file* file;
+    const codegen_config& config;
+    std::unique_ptr<two_pass_generation> generation;
+
+    // By node id, for the file's top-level declarations
+    std::vector<progress> declarations;
+
+    // Declarations that refer to a name, directly or indirectly, that hasn't been declared yet, by that name
+    std::unordered_map<ast::symbol_id, std::vector<ast::node*>> waiting;
+
+    // Set once a name has been declared more than once
+    bool redeclared = false;
+};
+
+cpp_pipeline_generator::cpp_pipeline_generator(ast::file* file, const codegen_config& config)
+{
+    intern_datatype_names(file, config);
+    impl = std::make_unique<state>(file, config);
+}
+
+cpp_pipeline_generator::~cpp_pipeline_generator() = default;
+
+void cpp_pipeline_generator::add(ast::node* declaration, ast::node_id node_count)
+{
+    impl->generation->grow(node_count);
+    impl->declarations.resize(node_count, state::progress::unknown);
+
+    const auto name = ast::declared_name(declaration);
+    if (name != ast::invalid_symbol && impl->generation->symbols.find(name)) impl->redeclared = true;
+    impl->generation->symbols.declare(declaration);
+
+    impl->try_generate(declaration);
+
+    // Declarations that were only waiting for this one may now be ready
+    if (name == ast::invalid_symbol) return;
+    auto it = impl->waiting.find(name);
+    if (it == impl->waiting.end()) return;
+    auto retry = std::move(it->second);
+    impl->waiting.erase(it);
+    for (auto* decl : retry) impl->try_generate(decl);
+}
+
+void cpp_pipeline_generator::finish(std::ostream& out)
+{
+    auto* file = impl->file;
+    symbol_table final_symbols(file, impl->config);
+    if (impl->rebound(final_symbols))
+    {
+        // Rare enough that starting over is simpler than working out what was affected
+        impl->generation = std::make_unique<two_pass_generation>(file, impl->config);
+        impl->declarations.assign(file->node_count(), state::progress::unknown);
+    }
+    else
+    {
+        impl->generation->symbols = std::move(final_symbols);
+        impl->generation->grow(file->node_count());
+        impl->declarations.resize(file->node_count(), state::progress::unknown);
+    }
+
+    // Names still missing now are never declared, or come from imports
     for (auto* child : file->children)
     {
-        generate_type(state, child);
+        if (impl->declarations[child->id] != state::progress::generated)
+        {
+            generate_type(impl->generation->first_pass, child);
+        }
     }
+    impl->generation->write(out, file);
+}
 
-    out << "// Auto-generated by ts-type-conv\n"
-        << "#pragma once\n\n";
+void generate_cpp_fragments(ast::file* file, const codegen_config& config,
+    const std::vector<ast::node*>& declarations, std::vector<cpp_fragment>& fragments)
+{
+    symbol_table symbols(file, config);
+    render_cache cache(file->node_count());
+    node_map<member_list> member_lists(file->node_count());
+    codegen_state state(config, symbols, cache, member_lists);
 
-    for (const auto& h : state.headers)
+    for (auto* decl : declarations)
     {
-        out << h << "\n";
+        state.buffer.str(std::string());
+        state.buffer.clear();
+        state.headers.clear();
+        generate_type(state, decl);
+
+        auto& fragment = fragments.emplace_back();
+        fragment.text = state.buffer.str();
+        fragment.headers = std::move(state.headers);
     }
-    if (!state.headers.empty()) out << "\n";
+}
+
+void write_cpp_fragments(std::ostream& out, const std::vector<const cpp_fragment*>& fragments)
+{
+    std::set<std::string, std::less<>> headers;
+    for (const auto* fragment : fragments) headers.insert(fragment->headers.begin(), fragment->headers.end());
 
-    out << state.out.str();
+    write_header(out, headers, [&](std::ostream& o) {
+        for (const auto* fragment : fragments) o << fragment->text;
+    });
 }
@@ -1,10 +1,84 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <iosfwd>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 #include "../ast.h"
 
 #include "../config.h"
 
-void generate_cpp(std::ostream& out, ast::file* file, const codegen_config& config);
+/**
+ * @brief Writes the C++ header for a file.
+ *
+ * @param thread_count The number of threads to generate declarations on; zero uses one per hardware thread. With
+ * more than one, the output is the same, but it's built in memory before it's written rather than streamed.
+ */
+void generate_cpp(std::ostream& out, ast::file* file, const codegen_config& config, std::size_t thread_count = 1);
+
+/**
+ * @brief The C++ for one top-level declaration, and the headers it needs.
+ */
+struct cpp_fragment
+{
+    std::string text;
+    std::set<std::string, std::less<>> headers;
+};
+
+/**
+ * @brief Generates the C++ for some of a file's top-level declarations, each into its own fragment, so that the output
+ * for declarations that haven't changed can be kept and reused.
+ *
+ * Passing the fragments for every child of the file, in order, to write_cpp_fragments() gives exactly the output of
+ * generate_cpp().
+ */
+void generate_cpp_fragments(ast::file* file, const codegen_config& config,
+    const std::vector<ast::node*>& declarations, std::vector<cpp_fragment>& fragments);
+
+/**
+ * @brief Writes a complete header made up of the given fragments, in order.
+ */
+void write_cpp_fragments(std::ostream& out, const std::vector<const cpp_fragment*>& fragments);
+
+/**
+ * @brief Generates the C++ for a file while it's still being parsed, from declarations passed in by the parser.
+ *
+ * The first pass of generate_cpp(), which renders types, flattens members and collects headers, runs on each
+ * declaration as soon as every name it refers to, directly or through other declarations, has been declared. The
+ * rest are deferred to finish(), when the whole file is known, which then writes exactly the output of
+ * generate_cpp().
+ *
+ * add() may be called from a different thread from the parser's, as long as each declaration is handed over safely:
+ * nothing the parser may still be changing, including the file's interner, is read before finish().
+ */
+class cpp_pipeline_generator
+{
+public:
+    /**
+     * @brief Must be constructed before parsing starts. Interns the config's datatype names in the file, which must
+     * not outlive the config, so that their ids are known without reading the interner later.
+     */
+    cpp_pipeline_generator(ast::file* file, const codegen_config& config);
+    ~cpp_pipeline_generator();
+
+    /**
+     * @brief Takes the file's next top-level declaration.
+     *
+     * @param node_count The file's node count once the declaration had been parsed.
+     */
+    void add(ast::node* declaration, ast::node_id node_count);
+
+    /**
+     * @brief Generates the deferred declarations and writes the output. Only called once the whole file has been
+     * parsed and any imports linked into it.
+     */
+    void finish(std::ostream& out);
+
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
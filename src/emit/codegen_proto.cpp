@@ -1,20 +1,22 @@
 #include "codegen_proto.h"
+#include "symbol_table.h"
 #include <ostream>
-#include <sstream>
 
 struct proto_state {
-    std::stringstream out;
+    // Proto has nothing that must come before the declarations, so they are written straight to the destination
+    std::ostream& out;
     const codegen_config& config;
+    const symbol_table& symbols;
 
-    proto_state(const codegen_config& conf) : config(conf) {}
+    proto_state(std::ostream& out, const codegen_config& conf, const symbol_table& symbols) :
+        out(out), config(conf), symbols(symbols) {}
 };
 
 static void generate_proto_type(proto_state& state, ast::node* type);
 
-static void check_config_proto(proto_state& state, const std::string& type_name, const std::string& fallback) {
-    auto it = state.config.datatypes.find(type_name);
-    if (it != state.config.datatypes.end()) {
-        state.out << it->second.out;
+static void check_config_proto(proto_state& state, ast::symbol_id type_name, std::string_view fallback) {
+    if (auto* dt = state.symbols.datatype(type_name)) {
+        state.out << dt->out;
     } else {
         state.out << fallback;
     }
@@ -26,10 +28,10 @@ static void generate_proto_object_body(proto_state& state, ast::object* obj) {
     for (auto* m : obj->named_members) {
         state.out << "    ";
         if (m->is_optional) state.out << "optional ";
-        else if (dynamic_cast<ast::array*>(m->type)) state.out << "repeated ";
+        else if (ast::node_cast<ast::array>(m->type)) state.out << "repeated ";
 
         ast::node* inner_type = m->type;
-        if (auto* arr = dynamic_cast<ast::array*>(m->type)) inner_type = arr->type;
+        if (auto* arr = ast::node_cast<ast::array>(m->type)) inner_type = arr->type;
 
         generate_proto_type(state, inner_type);
         state.out << " " << m->name << " = " << tag++ << ";\n";
@@ -37,68 +39,122 @@ static void generate_proto_object_body(proto_state& state, ast::object* obj) {
     state.out << "}\n";
 }
 
-static void generate_proto_type(proto_state& state, ast::node* type) {
-    if (!type) { check_config_proto(state, "any", "google.protobuf.Any"); return; }
+/**
+ * @brief Node visitor that emits the proto for a declaration or type expression.
+ */
+struct proto_type_generator {
+    proto_state& state;
 
-    if (auto* mod = dynamic_cast<ast::module*>(type)) {
+    void operator()(ast::module* mod) {
         state.out << "package " << mod->name << ";\n\n";
         for (auto* child : mod->children) generate_proto_type(state, child);
-    } else if (auto* imp = dynamic_cast<ast::import_stmt*>(type)) {
+    }
+
+    void operator()(ast::import_stmt* imp) {
         state.out << "import \"" << imp->module_name << ".proto\";\n\n";
-    } else if (auto* iface = dynamic_cast<ast::interface*>(type)) {
+    }
+
+    void operator()(ast::interface* iface) {
         state.out << "message " << iface->name << " ";
         if (iface->definition) generate_proto_object_body(state, iface->definition);
         else state.out << "{}\n";
         state.out << "\n";
-    } else if (auto* en = dynamic_cast<ast::enumeration*>(type)) {
+    }
+
+    void operator()(ast::enumeration* en) {
         state.out << "enum " << en->name << " {\n";
         int tag = 0;
         for (const auto& member : en->members) {
             state.out << "    " << member.name << " = " << tag++ << ";\n";
         }
         state.out << "}\n\n";
-    } else if (auto* alias = dynamic_cast<ast::type_alias*>(type)) {
-        if (auto* obj = dynamic_cast<ast::object*>(alias->target_type)) {
+    }
+
+    void operator()(ast::type_alias* alias) {
+        if (auto* obj = ast::node_cast<ast::object>(alias->target_type)) {
             state.out << "message " << alias->name << " ";
             generate_proto_object_body(state, obj);
             state.out << "\n";
         } else {
             // Unhandled natively in proto without struct wrapper
         }
-    } else if (auto* f = dynamic_cast<ast::fundamental_type_reference*>(type)) {
+    }
+
+    void operator()(ast::fundamental_type_reference* f) {
         switch (f->type) {
-        case ast::fundamental_type::any: check_config_proto(state, "any", "google.protobuf.Any"); break;
-        case ast::fundamental_type::boolean: check_config_proto(state, "boolean", "bool"); break;
-        case ast::fundamental_type::number: check_config_proto(state, "number", "double"); break;
-        case ast::fundamental_type::string: check_config_proto(state, "string", "string"); break;
-        case ast::fundamental_type::unknown: check_config_proto(state, "unknown", "google.protobuf.Any"); break;
-        case ast::fundamental_type::never: check_config_proto(state, "never", "google.protobuf.Any"); break;
+        case ast::fundamental_type::any: check_config_proto(state, ast::builtin::any, "google.protobuf.Any"); break;
+        case ast::fundamental_type::boolean: check_config_proto(state, ast::builtin::boolean, "bool"); break;
+        case ast::fundamental_type::number: check_config_proto(state, ast::builtin::number, "double"); break;
+        case ast::fundamental_type::string: check_config_proto(state, ast::builtin::string, "string"); break;
+        case ast::fundamental_type::unknown: check_config_proto(state, ast::builtin::unknown, "google.protobuf.Any"); break;
+        case ast::fundamental_type::never: check_config_proto(state, ast::builtin::never, "google.protobuf.Any"); break;
         }
-    } else if (auto* ref = dynamic_cast<ast::interface_reference*>(type)) {
-        check_config_proto(state, ref->name, ref->name);
-    } else if (auto* arr = dynamic_cast<ast::array*>(type)) {
+    }
+
+    void operator()(ast::interface_reference* ref) {
+        check_config_proto(state, ref->name_id, ref->name);
+    }
+
+    void operator()(ast::array* arr) {
         // Repeated arrays handled dynamically inside object members, or just array wrapper
         generate_proto_type(state, arr->type);
-    } else if (auto* gref = dynamic_cast<ast::generic_type_reference*>(type)) {
-        if (gref->name == "Array" || gref->name == "ReadonlyArray") {
+    }
+
+    void operator()(ast::generic_type_reference* gref) {
+        if (gref->name_id == ast::builtin::Array || gref->name_id == ast::builtin::ReadonlyArray) {
             if (!gref->arguments.empty()) generate_proto_type(state, gref->arguments[0]);
             else state.out << "google.protobuf.Any";
+        } else if (gref->name_id == ast::builtin::type_query) {
+            check_config_proto(state, ast::builtin::any, "google.protobuf.Any");
         } else {
-            check_config_proto(state, gref->name, gref->name);
+            check_config_proto(state, gref->name_id, gref->name);
         }
-    } else {
+    }
+
+    template <typename T>
+    void operator()(T*) {
         state.out << "/* unmapped */";
     }
+};
+
+static void generate_proto_type(proto_state& state, ast::node* type) {
+    if (!type) { check_config_proto(state, ast::builtin::any, "google.protobuf.Any"); return; }
+
+    ast::visit(type, proto_type_generator{ state });
 }
 
-void generate_proto(std::ostream& out, ast::file* file, const codegen_config& config) {
-    proto_state state(config);
+static void write_preamble(std::ostream& out) {
     out << "// Auto-generated by ts-type-conv\n";
     out << "syntax = \"proto3\";\n\n";
+}
+
+void generate_proto(std::ostream& out, ast::file* file, const codegen_config& config) {
+    symbol_table symbols(file, config);
+    proto_state state(out, config, symbols);
+    write_preamble(out);
 
     for (auto* child : file->children) {
         generate_proto_type(state, child);
     }
+}
+
+struct proto_pipeline_generator::state {
+    state(std::ostream& out, ast::file* file, const codegen_config& config) :
+        symbols(file, config), proto(out, config, symbols) {}
+
+    // Only the config's overrides are looked up in it, and those are known before parsing starts
+    symbol_table symbols;
+    proto_state proto;
+};
+
+proto_pipeline_generator::proto_pipeline_generator(std::ostream& out, ast::file* file, const codegen_config& config) {
+    for (const auto& [name, entry] : config.datatypes) file->symbols.intern(name);
+    impl = std::make_unique<state>(out, file, config);
+    write_preamble(out);
+}
+
+proto_pipeline_generator::~proto_pipeline_generator() = default;
 
-    out << state.out.str();
+void proto_pipeline_generator::add(ast::node* declaration) {
+    generate_proto_type(impl->proto, declaration);
 }
@@ -1,7 +1,35 @@
 #pragma once
 
 #include <iosfwd>
+#include <memory>
 #include "../ast.h"
 #include "../config.h"
 
 void generate_proto(std::ostream& out, ast::file* file, const codegen_config& config);
+
+/**
+ * @brief Generates the proto for a file while it's still being parsed, writing each declaration as soon as it's passed
+ * in by the parser. Nothing in proto depends on what comes later in the file, so the output is exactly that of
+ * generate_proto().
+ *
+ * add() may be called from a different thread from the parser's, as long as each declaration is handed over safely.
+ */
+class proto_pipeline_generator
+{
+public:
+    /**
+     * @brief Must be constructed before parsing starts. Interns the config's datatype names in the file, which must
+     * not outlive the config, and writes the start of the output.
+     */
+    proto_pipeline_generator(std::ostream& out, ast::file* file, const codegen_config& config);
+    ~proto_pipeline_generator();
+
+    /**
+     * @brief Writes the proto for the file's next top-level declaration.
+     */
+    void add(ast::node* declaration);
+
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
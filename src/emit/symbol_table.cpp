@@ -0,0 +1,34 @@
+#include "symbol_table.h"
+
+symbol_table::symbol_table(const ast::file* file, const codegen_config& config) :
+    known_nodes(file->symbols.size(), nullptr),
+    datatypes(file->symbols.size(), nullptr)
+{
+    for (auto* child : file->children)
+    {
+        auto id = ast::declared_name(child);
+        if (id != ast::invalid_symbol) known_nodes[id] = child;
+    }
+
+    // The file's own declarations shadow imported ones of the same name
+    for (auto* decl : file->imported)
+    {
+        auto id = ast::declared_name(decl);
+        if (id != ast::invalid_symbol && !known_nodes[id]) known_nodes[id] = decl;
+    }
+
+    // Names that never appear in the file can't be referenced, so their overrides are irrelevant
+    for (const auto& [name, entry] : config.datatypes)
+    {
+        auto id = file->symbols.find(name);
+        if (id != ast::invalid_symbol) datatypes[id] = &entry;
+    }
+}
+
+void symbol_table::declare(ast::node* decl)
+{
+    auto id = ast::declared_name(decl);
+    if (id == ast::invalid_symbol) return;
+    if (id >= known_nodes.size()) known_nodes.resize(id + 1, nullptr);
+    known_nodes[id] = decl;
+}
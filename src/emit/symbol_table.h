@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "../ast.h"
+#include "../config.h"
+
+/**
+ * @brief Resolves the names used in a file to their declarations and configured overrides, by symbol id.
+ *
+ * Built once per file before generation starts and only read afterwards, so every nested generation context shares the
+ * same instance. Each configuration override is looked up once here rather than once per use.
+ */
+struct symbol_table
+{
+    symbol_table(const ast::file* file, const codegen_config& config);
+
+    /**
+     * @brief Adds a top-level declaration parsed after the table was built. As in the constructor, a later
+     * declaration of a name replaces an earlier one.
+     */
+    void declare(ast::node* decl);
+
+    /**
+     * @brief Returns the top-level interface, type alias or enum with the given name, declared in the file or copied into
+     * it from an imported file, or nullptr.
+     */
+    ast::node* find(ast::symbol_id id) const
+    {
+        return (id < known_nodes.size()) ? known_nodes[id] : nullptr;
+    }
+
+    /**
+     * @brief Returns the [datatype.<name>] override for the given name, or nullptr.
+     */
+    const datatype_config* datatype(ast::symbol_id id) const
+    {
+        return (id < datatypes.size()) ? datatypes[id] : nullptr;
+    }
+
+private:
+    std::vector<ast::node*> known_nodes;
+    std::vector<const datatype_config*> datatypes;
+};
@@ -0,0 +1,117 @@
+#include "file_io.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+bool read_file(const std::filesystem::path& path, std::string& contents, std::ios::openmode mode)
+{
+    std::ifstream file(path, mode | std::ios::in);
+    if (!file) return false;
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+bool replace_file(const std::filesystem::path& path, std::string_view contents, std::ios::openmode mode)
+{
+    // Seeded randomly, so that other processes writing to the same directory pick different names too
+    static std::atomic<std::uint64_t> counter{ std::random_device()() };
+    auto temp_path = path;
+    temp_path += ".tmp" + std::to_string(counter++);
+
+    std::error_code ec;
+    {
+        std::ofstream temp(temp_path, mode | std::ios::out | std::ios::trunc);
+        if (!temp.write(contents.data(), static_cast<std::streamsize>(contents.size())) || !temp.flush()) {
+            temp.close();
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    // The temporary file is new, so give it the permissions of the file it replaces, as writing in place would keep
+    const auto existing = std::filesystem::status(path, ec);
+    if (!ec && std::filesystem::exists(existing)) {
+        std::filesystem::permissions(temp_path, existing.permissions(), std::filesystem::perm_options::replace, ec);
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+file_writer::file_writer(double* write_ms) : buffer(block_size), write_ms(write_ms)
+{
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+file_writer::~file_writer()
+{
+    close();
+}
+
+bool file_writer::open(const std::filesystem::path& path, std::ios::openmode mode)
+{
+    // Unbuffered, as every write to it is already a whole block
+    file.pubsetbuf(nullptr, 0);
+    open_path = path;
+    open_mode = mode | std::ios::out | std::ios::trunc;
+    failed = !file.open(open_path, open_mode);
+    return !failed;
+}
+
+void file_writer::discard()
+{
+    setp(buffer.data(), buffer.data() + buffer.size());
+    written = 0;
+    if (!file.is_open()) return;
+
+    // Reopening truncates it again
+    file.close();
+    failed = !file.open(open_path, open_mode);
+}
+
+bool file_writer::close()
+{
+    if (!file.is_open()) return !failed;
+    write_block();
+    if (!file.close()) failed = true;
+    return !failed;
+}
+
+bool file_writer::write_block()
+{
+    const auto size = static_cast<std::streamsize>(pptr() - pbase());
+    if (size == 0) return !failed;
+
+    const auto start = std::chrono::steady_clock::now();
+    if (failed || file.sputn(pbase(), size) != size) failed = true;
+    if (write_ms) *write_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    written += static_cast<std::uint64_t>(size);
+    setp(buffer.data(), buffer.data() + buffer.size());
+    return !failed;
+}
+
+file_writer::int_type file_writer::overflow(int_type ch)
+{
+    if (!write_block()) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int file_writer::sync()
+{
+    return (write_block() && file.pubsync() == 0) ? 0 : -1;
+}
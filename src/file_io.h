@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Reads a whole file into 'contents'.
+ *
+ * @return False if the file doesn't exist or couldn't be read.
+ */
+bool read_file(const std::filesystem::path& path, std::string& contents, std::ios::openmode mode = std::ios::in);
+
+/**
+ * @brief Writes 'contents' to a temporary file next to 'path', then renames it over 'path'.
+ *
+ * Readers see either the old file or the complete new one, never a partial write, and concurrent writers never
+ * share a temporary file.
+ *
+ * @return False if the file couldn't be written; 'path' is left as it was.
+ */
+bool replace_file(const std::filesystem::path& path, std::string_view contents, std::ios::openmode mode = std::ios::out);
+
+/**
+ * @brief A stream buffer that writes a file in large blocks, so that output produced a few bytes at a time reaches
+ * the OS in a few large writes without ever being held in memory as a whole.
+ */
+class file_writer : public std::streambuf
+{
+public:
+    static constexpr std::size_t block_size = 256 * 1024;
+
+    /**
+     * @param write_ms If not null, the wall time spent handing blocks to the OS is added to it, in milliseconds.
+     */
+    explicit file_writer(double* write_ms = nullptr);
+    ~file_writer() override;
+
+    file_writer(const file_writer&) = delete;
+    file_writer& operator=(const file_writer&) = delete;
+
+    bool open(const std::filesystem::path& path, std::ios::openmode mode = std::ios::out);
+
+    /**
+     * @brief Writes out whatever is still buffered and closes the file.
+     *
+     * @return False if any of the output couldn't be written.
+     */
+    bool close();
+
+    /**
+     * @brief Throws away everything written so far, leaving the file empty.
+     */
+    void discard();
+
+    std::uint64_t bytes_written() const noexcept { return written + static_cast<std::uint64_t>(pptr() - pbase()); }
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    bool write_block();
+
+    std::filebuf file;
+    std::filesystem::path open_path; // Kept so that discard can reopen it
+    std::ios::openmode open_mode = std::ios::out;
+    std::vector<char> buffer;
+    double* write_ms;
+    std::uint64_t written = 0; // Bytes handed to the file so far, not counting what's buffered
+    bool failed = false;
+};
@@ -0,0 +1,157 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How long the files must go without another write before a change is reported, so that an editor saving in several
+// steps (or saving several files at once) only triggers one update
+static constexpr std::chrono::milliseconds settle_time{ 50 };
+static constexpr std::chrono::milliseconds poll_interval{ 250 };
+
+file_watcher::file_watcher(std::vector<std::string> paths)
+{
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+#endif
+    for (auto& p : paths) add(std::move(p));
+}
+
+std::size_t file_watcher::add(std::string path)
+{
+    auto& file = files.emplace_back();
+    file.path = std::move(path);
+
+    std::error_code ec;
+    file.modified = std::filesystem::last_write_time(file.path, ec);
+    file.size = std::filesystem::file_size(file.path, ec);
+
+#ifdef __linux__
+    watch_directory(file);
+#endif
+    return files.size() - 1;
+}
+
+#ifdef __linux__
+void file_watcher::watch_directory(watched_file& file)
+{
+    if (inotify_fd < 0) return;
+
+    auto directory = file.path.parent_path();
+    if (directory.empty()) directory = ".";
+
+    // Adding the same directory twice returns the same watch descriptor
+    file.directory_watch = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (file.directory_watch < 0)
+    {
+        // Fall back to polling for every file rather than only noticing changes to some of them
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+}
+#endif
+
+file_watcher::~file_watcher()
+{
+#ifdef __linux__
+    if (inotify_fd >= 0) close(inotify_fd);
+#endif
+}
+
+/**
+ * @brief Compares every file's modification time and size against what was last seen.
+ *
+ * @return True if any file changed.
+ */
+bool file_watcher::poll(std::vector<std::size_t>& changed)
+{
+    bool any = false;
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        auto& file = files[i];
+        std::error_code ec;
+        const auto modified = std::filesystem::last_write_time(file.path, ec);
+        if (ec) continue; // Likely mid-save; it will be back
+        const auto size = std::filesystem::file_size(file.path, ec);
+        if (ec || (modified == file.modified && size == file.size)) continue;
+
+        file.modified = modified;
+        file.size = size;
+        if (std::find(changed.begin(), changed.end(), i) == changed.end()) changed.push_back(i);
+        any = true;
+    }
+    return any;
+}
+
+bool file_watcher::wait(std::vector<std::size_t>& changed)
+{
+    changed.clear();
+
+#ifdef __linux__
+    if (inotify_fd >= 0)
+    {
+        alignas(inotify_event) char buffer[16 * 1024];
+        int timeout = -1;
+        for (;;)
+        {
+            pollfd pfd{ inotify_fd, POLLIN, 0 };
+            const int ready = ::poll(&pfd, 1, timeout);
+            if (ready < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (ready == 0) break; // Settled
+
+            const ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    // Events were lost; assume everything changed
+                    for (std::size_t i = 0; i < files.size(); ++i) changed.push_back(i);
+                    continue;
+                }
+                if (event->len == 0) continue;
+
+                const std::string_view name = event->name;
+                for (std::size_t i = 0; i < files.size(); ++i)
+                {
+                    const auto& file = files[i];
+                    if (file.directory_watch == event->wd && file.path.filename().native() == name) changed.push_back(i);
+                }
+            }
+
+            if (!changed.empty()) timeout = static_cast<int>(settle_time.count());
+        }
+
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return true;
+    }
+#endif
+
+    while (!poll(changed)) std::this_thread::sleep_for(poll_interval);
+    do {
+        std::this_thread::sleep_for(settle_time);
+    } while (poll(changed));
+    std::sort(changed.begin(), changed.end());
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Waits for any of a set of files to be written.
+ *
+ * Uses inotify on Linux, watching each file's directory so that editors which save by writing a new file and renaming
+ * it over the old one are still noticed. Elsewhere, the files' modification times and sizes are polled.
+ */
+class file_watcher
+{
+public:
+    explicit file_watcher(std::vector<std::string> paths);
+    ~file_watcher();
+
+    file_watcher(const file_watcher&) = delete;
+    file_watcher& operator=(const file_watcher&) = delete;
+
+    /**
+     * @brief Starts watching another file too.
+     *
+     * @return Its index, following those of the files already watched.
+     */
+    std::size_t add(std::string path);
+
+    /**
+     * @brief Blocks until at least one file has changed, then waits for writes to settle.
+     *
+     * @param changed Receives the index, in the constructor's list, of every file that changed.
+     * @return False if the files can no longer be watched.
+     */
+    bool wait(std::vector<std::size_t>& changed);
+
+private:
+    struct watched_file
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type modified{};
+        std::uintmax_t size = 0;
+        int directory_watch = -1;
+    };
+
+    bool poll(std::vector<std::size_t>& changed);
+    void watch_directory(watched_file& file);
+
+    std::vector<watched_file> files;
+    int inotify_fd = -1;
+};
@@ -0,0 +1,291 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <ostream>
+#include <sstream>
+#include <unordered_set>
+
+#include "emit/codegen_proto.h"
+
+// Once the buffers kept alive for old statements outweigh the current text by this factor, the text is parsed again
+// from scratch so that they can be released
+static constexpr std::size_t compaction_factor = 4;
+static constexpr std::size_t compaction_minimum = 64 * 1024;
+
+void incremental_file::make_statements(const std::vector<parsed_statement>& parsed, std::size_t base,
+    std::vector<statement>& out)
+{
+    for (const auto& p : parsed)
+    {
+        auto& s = out.emplace_back();
+        s.begin = base + p.offset;
+        s.node = p.node;
+        s.declares = ast::declared_name(p.node);
+        ast::collect_references(p.node, s.references);
+        std::sort(s.references.begin(), s.references.end());
+        s.references.erase(std::unique(s.references.begin(), s.references.end()), s.references.end());
+    }
+}
+
+/**
+ * @brief Parses the whole text into a new file, committing to it only if it parses successfully.
+ *
+ * @param keep_output True if the text is the same as before, so that the output generated for each statement still
+ * applies.
+ */
+bool incremental_file::parse_all(std::string_view text, bool keep_output, std::ostream& diagnostics)
+{
+    auto new_file = std::make_unique<ast::file>();
+    std::vector<parsed_statement> parsed;
+    if (!parse_statements(text, new_file.get(), true, parsed, diagnostics)) return false;
+
+    std::vector<statement> new_statements;
+    file = std::move(new_file);
+    make_statements(parsed, 0, new_statements);
+
+    if (keep_output && new_statements.size() == statements.size())
+    {
+        for (std::size_t i = 0; i < statements.size(); ++i)
+        {
+            new_statements[i].fragment = std::move(statements[i].fragment);
+            new_statements[i].needs_generation = statements[i].needs_generation;
+        }
+    }
+    statements = std::move(new_statements);
+    return true;
+}
+
+bool incremental_file::update(std::unique_ptr<source_buffer> source, std::ostream& diagnostics)
+{
+    const std::string_view text = source->text();
+    last_reparsed = 0;
+    last_regenerated = 0;
+
+    if (!file)
+    {
+        sources.push_back(std::move(source));
+        if (!parse_all(text, false, diagnostics))
+        {
+            sources.clear();
+            return false;
+        }
+        retained_bytes = text.size();
+        last_reparsed = statements.size();
+        generate(true, diagnostics);
+        return true;
+    }
+
+    // Nothing to parse, but an imported file may have changed
+    const std::string_view old_text = sources.back()->text();
+    if (text == old_text)
+    {
+        generate(false, diagnostics);
+        return true;
+    }
+
+    // The edited span: everything between the longest common prefix and the longest common suffix
+    const std::size_t max_common = std::min(text.size(), old_text.size());
+    std::size_t prefix = 0;
+    while (prefix < max_common && text[prefix] == old_text[prefix]) ++prefix;
+    std::size_t suffix = 0;
+    while (suffix < max_common - prefix && text[text.size() - 1 - suffix] == old_text[old_text.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    const std::size_t old_edit_end = old_text.size() - suffix;
+    const auto delta = static_cast<std::ptrdiff_t>(text.size()) - static_cast<std::ptrdiff_t>(old_text.size());
+
+    auto starts_before = [](const statement& s, std::size_t pos) { return s.begin < pos; };
+    auto starts_after = [](std::size_t pos, const statement& s) { return pos < s.begin; };
+
+    // The first statement to parse again is the one containing the character before the edit, as text added right at
+    // the end of a statement may belong to it. The first to keep after it must start, and be preceded by a character,
+    // outside of the edit, so that the edit can't have joined its first token onto something else.
+    std::size_t first = std::lower_bound(statements.begin(), statements.end(), prefix, starts_before) - statements.begin();
+    if (first > 0) --first;
+    std::size_t last = std::upper_bound(statements.begin(), statements.end(), old_edit_end, starts_after) - statements.begin();
+
+    auto region_end = [&](std::size_t index) {
+        return (index < statements.size()) ? static_cast<std::size_t>(statements[index].begin + delta) : text.size();
+    };
+    const std::size_t region_begin = (first > 0) ? statements[first].begin : 0;
+
+    // A line comment running up to the end of the region would carry on into the next statement in the full text
+    while (last < statements.size())
+    {
+        auto region = text.substr(region_begin, region_end(last) - region_begin);
+        auto last_line = region.substr(std::min(region.size(), region.rfind('\n') + 1));
+        if (last_line.find("//") == std::string_view::npos) break;
+        ++last;
+    }
+
+    sources.push_back(std::move(source));
+
+    // The region ends as a file does, where a statement cut short can still parse, e.g. an enum missing its '}'. So the
+    // first statement kept after it is parsed too, and must still start where it did; it's then dropped, as the one
+    // already parsed from the same text is kept.
+    std::vector<parsed_statement> parsed;
+    std::ostringstream region_diagnostics;
+    const std::size_t kept_begin = region_end(last) - region_begin;
+    const auto region = text.substr(region_begin, region_end(std::min(last + 1, statements.size())) - region_begin);
+    bool region_parsed = parse_statements(region, file.get(), first == 0, parsed, region_diagnostics);
+    if (region_parsed && last < statements.size())
+    {
+        region_parsed = !parsed.empty() && parsed.back().offset == kept_begin;
+        if (region_parsed) parsed.pop_back();
+    }
+    if (!region_parsed)
+    {
+        // The edit may make a statement run on past the region, e.g. by leaving a comment or a brace open, which only
+        // parsing the whole text gets right. If that fails too, its errors are the ones worth reporting.
+        if (!parse_all(text, false, diagnostics))
+        {
+            // Parsing the region interned names viewing the new text, so it's kept, though behind the text the
+            // statements were last parsed from
+            std::iter_swap(sources.end() - 2, sources.end() - 1);
+            retained_bytes += text.size();
+            return false;
+        }
+        sources.erase(sources.begin(), sources.end() - 1);
+        retained_bytes = text.size();
+        last_reparsed = statements.size();
+        generate(true, diagnostics);
+        return true;
+    }
+    diagnostics << region_diagnostics.str();
+    retained_bytes += text.size();
+
+    std::vector<statement> replacement;
+    make_statements(parsed, region_begin, replacement);
+    last_reparsed = replacement.size();
+
+    // Names whose declaration went away or was replaced; anything referring to them must be generated again
+    std::unordered_set<ast::symbol_id> changed;
+    for (std::size_t i = first; i < last; ++i)
+    {
+        if (statements[i].declares != ast::invalid_symbol) changed.insert(statements[i].declares);
+    }
+    for (const auto& s : replacement)
+    {
+        if (s.declares != ast::invalid_symbol) changed.insert(s.declares);
+    }
+
+    for (std::size_t i = last; i < statements.size(); ++i) statements[i].begin += delta;
+    statements.erase(statements.begin() + first, statements.begin() + last);
+    statements.insert(statements.begin() + first, std::make_move_iterator(replacement.begin()),
+        std::make_move_iterator(replacement.end()));
+
+    // Spread the changes to everything that refers to a changed name, and then to what refers to those, and so on
+    for (bool spreading = !changed.empty(); spreading;)
+    {
+        spreading = false;
+        for (auto& s : statements)
+        {
+            if (s.needs_generation) continue;
+            for (auto ref : s.references)
+            {
+                if (!changed.count(ref)) continue;
+                s.needs_generation = true;
+                if (s.declares != ast::invalid_symbol && changed.insert(s.declares).second) spreading = true;
+                break;
+            }
+        }
+    }
+
+    generate(false, diagnostics);
+
+    if (retained_bytes > compaction_factor * std::max(text.size(), compaction_minimum))
+    {
+        const auto regenerated = last_regenerated;
+        std::ostringstream ignored;
+        if (parse_all(text, true, ignored))
+        {
+            sources.erase(sources.begin(), sources.end() - 1);
+            retained_bytes = text.size();
+            generate(true, ignored);
+        }
+        last_regenerated = regenerated;
+    }
+    return true;
+}
+
+/**
+ * @brief Copies in the imported declarations the statements refer to.
+ */
+void incremental_file::link_imports(bool new_file, std::ostream& diagnostics)
+{
+    if (!settings.modules) return;
+
+    std::vector<std::string> missing;
+    auto resolved = settings.modules->load_imports(*file, directory, missing, diagnostics);
+    if (!new_file && resolved != imports)
+    {
+        // Any name may now mean something else
+        file->imported.clear();
+        for (auto& s : statements) s.needs_generation = true;
+    }
+    imports = std::move(resolved);
+    module_graph::link(*file, imports);
+}
+
+/**
+ * @param new_file True if 'file' was just created rather than updated.
+ */
+void incremental_file::generate(bool new_file, std::ostream& diagnostics)
+{
+    file->children.clear();
+    for (const auto& s : statements)
+    {
+        if (s.node) file->children.push_back(s.node);
+    }
+    link_imports(new_file, diagnostics);
+
+    std::vector<ast::node*> declarations;
+    for (auto& s : statements)
+    {
+        if (!s.needs_generation) continue;
+        if (s.node) {
+            declarations.push_back(s.node);
+        } else {
+            s.needs_generation = false;
+        }
+    }
+    last_regenerated = declarations.size();
+
+    if (settings.format == "proto")
+    {
+        // Proto output is generated in one go when written
+        for (auto& s : statements) s.needs_generation = false;
+        return;
+    }
+
+    std::vector<cpp_fragment> fragments;
+    fragments.reserve(declarations.size());
+    generate_cpp_fragments(file.get(), settings.config, declarations, fragments);
+
+    std::size_t next = 0;
+    for (auto& s : statements)
+    {
+        if (!s.needs_generation) continue;
+        s.fragment = std::move(fragments[next++]);
+        s.needs_generation = false;
+    }
+}
+
+void incremental_file::write(std::ostream& out) const
+{
+    if (!file) return;
+
+    if (settings.format == "proto")
+    {
+        generate_proto(out, file.get(), settings.config);
+        return;
+    }
+
+    std::vector<const cpp_fragment*> fragments;
+    fragments.reserve(statements.size());
+    for (const auto& s : statements)
+    {
+        if (s.node) fragments.push_back(&s.fragment);
+    }
+    write_cpp_fragments(out, fragments);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "ast.h"
+#include "driver.h"
+#include "parser.h"
+#include "module_graph.h"
+#include "source_buffer.h"
+#include "emit/codegen_cpp.h"
+
+/**
+ * @brief A file that is converted again every time it's edited, re-parsing and re-generating only what changed.
+ *
+ * The text is split into top-level statements. After an edit, the statements in the unchanged text before and after
+ * the edited span keep their AST nodes and generated C++, and only the statements overlapping the edit are parsed
+ * again, into the same file. A kept declaration is generated again only if a name it refers to, directly or through
+ * other declarations, was added, removed or changed.
+ */
+class incremental_file
+{
+public:
+    /**
+     * @param directory What the file's relative imports are relative to, when settings.modules is set.
+     */
+    explicit incremental_file(const conversion_settings& settings, std::filesystem::path directory = ".") :
+        settings(settings), directory(std::move(directory)) {}
+
+    /**
+     * @brief Brings the output up to date with the file's new text, and with any changes to the files it imports.
+     *
+     * @return False if the new text has a syntax error, in which case the output for the previous text is kept.
+     */
+    bool update(std::unique_ptr<source_buffer> source, std::ostream& diagnostics);
+
+    /**
+     * @brief Writes the output for the latest text that parsed successfully.
+     */
+    void write(std::ostream& out) const;
+
+    std::size_t statement_count() const noexcept { return statements.size(); }
+
+    /**
+     * @brief The files the latest update resolved the file's imports to, when settings.modules is set.
+     */
+    const std::vector<const source_module*>& imported_modules() const noexcept { return imports; }
+
+    /**
+     * @brief The number of statements parsed, and of declarations generated, by the latest update.
+     */
+    std::size_t reparsed_count() const noexcept { return last_reparsed; }
+    std::size_t regenerated_count() const noexcept { return last_regenerated; }
+
+private:
+    struct statement
+    {
+        // Where the statement starts in the current text; it runs until the next one starts
+        std::size_t begin = 0;
+
+        // The declaration, or nullptr for statements that don't declare anything
+        ast::node* node = nullptr;
+
+        // The name other declarations would refer to this one by, if any
+        ast::symbol_id declares = ast::invalid_symbol;
+
+        // Every name used within the declaration
+        std::vector<ast::symbol_id> references;
+
+        cpp_fragment fragment;
+        bool needs_generation = true;
+    };
+
+    bool parse_all(std::string_view text, bool keep_output, std::ostream& diagnostics);
+    void make_statements(const std::vector<parsed_statement>& parsed, std::size_t base, std::vector<statement>& out);
+    void link_imports(bool new_file, std::ostream& diagnostics);
+    void generate(bool new_file, std::ostream& diagnostics);
+
+    const conversion_settings& settings;
+    const std::filesystem::path directory;
+
+    // What the import statements resolved to when the file was last linked
+    std::vector<const source_module*> imports;
+
+    std::unique_ptr<ast::file> file;
+
+    // Every buffer that names in 'file' may refer to; the last one holds the current text
+    std::vector<std::unique_ptr<source_buffer>> sources;
+    std::size_t retained_bytes = 0;
+
+    std::vector<statement> statements;
+
+    std::size_t last_reparsed = 0;
+    std::size_t last_regenerated = 0;
+};
@@ -1,38 +1,86 @@
 
 #include "lexer.h"
 
+#include <cstdarg>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
 using namespace std::literals;
 
-static constexpr bool is_whitespace(char ch) noexcept
+struct keyword
 {
-    return (ch == ' ') || (ch == '\f') || (ch == '\n') || (ch == '\r') ||
-        (ch == '\t') || (ch == '\v');
-}
+    std::string_view text;
+    token value = token::identifier;
+};
+
+static constexpr keyword keywords[] = {
+    { "string"sv, token::type_string },
+    { "boolean"sv, token::type_boolean },
+    { "number"sv, token::type_number },
+    { "any"sv, token::type_any },
+    { "export"sv, token::keyword_export },
+    { "interface"sv, token::keyword_interface },
+    { "extends"sv, token::keyword_extends },
+    { "module"sv, token::keyword_module },
+    { "namespace"sv, token::keyword_module },
+    { "type"sv, token::keyword_type },
+    { "keyof"sv, token::keyword_keyof },
+    { "in"sv, token::keyword_in },
+    { "unknown"sv, token::keyword_unknown },
+    { "never"sv, token::keyword_never },
+    { "import"sv, token::keyword_import },
+    { "from"sv, token::keyword_from },
+    { "enum"sv, token::keyword_enum },
+    { "declare"sv, token::keyword_declare },
+    { "readonly"sv, token::keyword_readonly },
+    { "null"sv, token::keyword_null },
+    { "undefined"sv, token::keyword_undefined },
+    { "typeof"sv, token::keyword_typeof },
+};
 
-static constexpr bool in_range(char ch, char begin, char end) noexcept
+static constexpr std::size_t keyword_table_size = 64;
+
+// The length plus the first and last characters are enough to tell every keyword apart, so a lookup is one hash and
+// at most one comparison. If a new keyword collides, the static_assert below fires and the constants need tweaking.
+static constexpr std::size_t keyword_hash(std::string_view str) noexcept
 {
-    return (ch >= begin) && (ch <= end);
+    return (str.size() + static_cast<unsigned char>(str.front()) + static_cast<unsigned char>(str.back()) * 26) %
+        keyword_table_size;
 }
 
-static constexpr bool is_valid_identifier_start(char ch) noexcept
+struct keyword_table
 {
-    return in_range(ch, 'A', 'Z') || in_range(ch, 'a', 'z') || ch == '_' || ch == '$';
-}
+    keyword slots[keyword_table_size] = {};
+    bool has_collision = false;
+};
 
-static constexpr bool is_valid_identifier_character(char ch) noexcept
+static constexpr keyword_table make_keyword_table() noexcept
 {
-    return is_valid_identifier_start(ch) || in_range(ch, '0', '9');
+    keyword_table result;
+    for (const auto& kw : keywords)
+    {
+        auto& slot = result.slots[keyword_hash(kw.text)];
+        if (!slot.text.empty()) result.has_collision = true;
+        slot = kw;
+    }
+    return result;
 }
 
-template <typename Func>
-static void skip_while(std::istream& input, Func&& func)
+static constexpr keyword_table keyword_lookup = make_keyword_table();
+static_assert(!keyword_lookup.has_collision, "keyword_hash no longer maps every keyword to a unique slot");
+
+static token keyword_or_identifier(std::string_view str) noexcept
 {
-    while (!input.fail() && func(static_cast<char>(input.peek()))) { input.get(); }
+    const auto& slot = keyword_lookup.slots[keyword_hash(str)];
+    return (slot.text == str) ? slot.value : token::identifier;
 }
 
-static void skip_whitespace(std::istream& input)
+template <typename Func>
+static const char* skip_while(const char* pos, const char* end, Func&& func)
 {
-    skip_while(input, is_whitespace);
+    while ((pos != end) && func(*pos)) { ++pos; }
+    return pos;
 }
 
 void lexer::advance()
@@ -40,19 +88,20 @@ void lexer::advance()
     current_token = token::invalid;
     do
     {
-        skip_whitespace(input);
-        if (input.eof())
+        // Most tokens are followed by no whitespace or a single space, which aren't worth a call
+        if ((cursor != end) && is_whitespace(*cursor))
         {
-            current_token = token::eof;
-            return;
+            ++cursor;
+            if ((cursor != end) && is_whitespace(*cursor)) cursor = scan.skip_whitespace(cursor + 1, end);
         }
-        else if (input.fail())
+        token_begin = cursor;
+        if (cursor == end)
         {
-            std::printf("ERROR: Failed to read data from file\n");
+            current_token = token::eof;
             return;
         }
 
-        auto ch = input.get();
+        auto ch = *cursor++;
         switch (ch)
         {
         case ';':
@@ -136,41 +185,26 @@ void lexer::advance()
             break;
 
         case '/':
-            if (input.peek() == '/')
+            if ((cursor != end) && (*cursor == '/'))
             {
-                // Read until the end of the line
-                skip_while(input, [](char ch) { return ch != '\n'; });
-                input.get(); // Consume the '\n'
+                // Read until the end of the line, consuming the '\n'
+                cursor = scan.find_newline(cursor + 1, end);
+                if (cursor != end) ++cursor;
             }
-            else if (input.peek() == '*')
+            else if ((cursor != end) && (*cursor == '*'))
             {
                 // Read until we get an ending '*/'
-                input.get(); // Consume the initial '*'
-                while (true)
+                cursor = scan.find_comment_end(cursor + 1, end); // Skip the initial '*'
+                if (cursor == end)
                 {
-                    skip_while(input, [](char ch) { return ch != '*'; });
-                    input.get(); // Consume the '*'
-                    if (input.peek() == '/')
-                    {
-                        input.get(); // Consume the '/'
-                        break;
-                    }
-
-                    if (input.eof())
-                    {
-                        std::printf("ERROR: End of file reached while parsing comment\n");
-                        return;
-                    }
-                    else if (input.fail())
-                    {
-                        std::printf("ERROR: Failed to read data from file\n");
-                        return;
-                    }
+                    report("ERROR: End of file reached while parsing comment\n");
+                    return;
                 }
+                cursor += 2; // Consume the '*/'
             }
             else
             {
-                std::printf("ERROR: Unexpected character '%c' after '/'\n", input.peek());
+                report("ERROR: Unexpected character '%c' after '/'\n", (cursor != end) ? *cursor : '\xff');
                 return;
             }
             break;
@@ -178,155 +212,69 @@ void lexer::advance()
         case '\'':
         case '\"':
         case '`':
+        {
             // NOTE: All strings we will be processing will be quite simple as they are almost exclusively used as
             // identifiers, so keep it simple for now
-            string_value.clear();
-            while (true)
+            auto begin = cursor;
+            cursor = skip_while(cursor, end, [ch](char next) { return next != ch; });
+            if (cursor == end)
             {
-                auto next = input.get();
-                if (next == ch)
-                {
-                    current_token = token::string;
-                    break;
-                }
-                else if (input.eof())
-                {
-                    std::printf("ERROR: End of file encountered while parsing string\n");
-                    return;
-                }
-                else if (input.fail())
-                {
-                    std::printf("ERROR: Failed to read data from file\n");
-                    return;
-                }
-                else
-                {
-                    string_value.push_back(static_cast<char>(next));
-                }
+                report("ERROR: End of file encountered while parsing string\n");
+                return;
             }
-            break;
+
+            string_value = std::string_view(begin, static_cast<std::size_t>(cursor - begin));
+            ++cursor; // Consume the closing quote
+            current_token = token::string;
+        }   break;
 
         case '0': case '1': case '2': case '3': case '4':
         case '5': case '6': case '7': case '8': case '9':
-            string_value.clear();
-            while (true)
-            {
-                string_value.push_back(static_cast<char>(ch));
-                auto next = input.peek();
-                if (in_range(static_cast<char>(next), '0', '9'))
-                {
-                    ch = input.get();
-                }
-                else if (!input.fail() || input.eof())
-                {
-                    break;
-                }
-                else
-                {
-                    std::printf("ERROR: Failed to read data from file\n");
-                    return;
-                }
-            }
+        {
+            auto begin = cursor - 1;
+            cursor = skip_while(cursor, end, [](char ch) { return in_range(ch, '0', '9'); });
+            string_value = std::string_view(begin, static_cast<std::size_t>(cursor - begin));
             current_token = token::number_literal;
-            break;
+        }   break;
 
         default:
-            if (is_valid_identifier_start(static_cast<char>(ch)))
+            if (is_valid_identifier_start(ch))
             {
-                string_value.clear();
-                while (true)
-                {
-                    string_value.push_back(static_cast<char>(ch));
-                    auto next = input.peek();
-                    if (is_valid_identifier_character(static_cast<char>(next)))
-                    {
-                        ch = input.get(); // Consume and keep going
-                    }
-                    else if (!input.fail() || input.eof())
-                    {
-                        break;
-                    }
-                    else
-                    {
-                        std::printf("ERROR: Failed to read data from file\n");
-                        return;
-                    }
-                }
+                auto begin = cursor - 1;
+                cursor = scan.skip_identifier(cursor, end);
+                string_value = std::string_view(begin, static_cast<std::size_t>(cursor - begin));
 
-                if (string_value == "string"sv)
-                {
-                    current_token = token::type_string;
-                }
-                else if (string_value == "boolean"sv)
-                {
-                    current_token = token::type_boolean;
-                }
-                else if (string_value == "number"sv)
-                {
-                    current_token = token::type_number;
-                }
-                else if (string_value == "any"sv)
-                {
-                    current_token = token::type_any;
-                }
-                else if (string_value == "export"sv)
-                {
-                    current_token = token::keyword_export;
-                }
-                else if (string_value == "interface"sv)
-                {
-                    current_token = token::keyword_interface;
-                }
-                else if (string_value == "extends"sv)
-                {
-                    current_token = token::keyword_extends;
-                }
-                else if (string_value == "module"sv || string_value == "namespace"sv)
-                {
-                    current_token = token::keyword_module;
-                }
-                else if (string_value == "type"sv)
-                {
-                    current_token = token::keyword_type;
-                }
-                else if (string_value == "keyof"sv)
-                {
-                    current_token = token::keyword_keyof;
-                }
-                else if (string_value == "in"sv)
-                {
-                    current_token = token::keyword_in;
-                }
-                else if (string_value == "unknown"sv)
-                {
-                    current_token = token::keyword_unknown;
-                }
-                else if (string_value == "never"sv)
-                {
-                    current_token = token::keyword_never;
-                }
-                else if (string_value == "import"sv)
-                {
-                    current_token = token::keyword_import;
-                }
-                else if (string_value == "from"sv)
-                {
-                    current_token = token::keyword_from;
-                }
-                else if (string_value == "enum"sv)
-                {
-                    current_token = token::keyword_enum;
-                }
-                else
-                {
-                    current_token = token::identifier;
-                }
+                current_token = keyword_or_identifier(string_value);
             }
             else
             {
-                std::printf("ERROR: Invalid character '%c'\n", ch);
+                report("ERROR: Invalid character '%c'\n", ch);
                 return;
             }
         }
     } while (current_token == token::invalid);
 }
+
+void lexer::report(const char* format, ...)
+{
+    // Most messages fit on the stack; longer ones, e.g. quoting long names, are formatted again at their full length
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    va_list retry;
+    va_copy(retry, args);
+    const int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length >= static_cast<int>(sizeof(buffer)))
+    {
+        std::string message(static_cast<std::size_t>(length), '\0');
+        std::vsnprintf(message.data(), message.size() + 1, format, retry);
+        diagnostics << message;
+    }
+    else if (length > 0)
+    {
+        diagnostics.write(buffer, length);
+    }
+    va_end(retry);
+}
@@ -1,8 +1,13 @@
 #pragma once
 
-#include <fstream>
+#include <iosfwd>
+#include <string_view>
 
 #include "ast.h"
+#include "scan.h"
+
+// Expands to the arguments for a "%.*s" printf conversion of a std::string_view
+#define SV_ARG(sv) static_cast<int>((sv).size()), (sv).data()
 
 enum class token
 {
@@ -42,6 +47,11 @@ enum class token
     keyword_import,
     keyword_from,
     keyword_enum,
+    keyword_declare,
+    keyword_readonly,
+    keyword_null,
+    keyword_undefined,
+    keyword_typeof,
 
     // Types
     type_any,
@@ -57,7 +67,15 @@ enum class token
 
 struct lexer
 {
-    lexer(std::istream& input, ast::file* file) : input(input), file(file) { advance(); }
+    lexer(std::string_view source, ast::file* file, std::ostream& diagnostics) :
+        cursor(source.data()),
+        end(source.data() + source.size()),
+        file(file),
+        diagnostics(diagnostics),
+        scan(active_scan_kernels())
+    {
+        advance();
+    }
 
     explicit operator bool() const noexcept
     {
@@ -66,8 +84,26 @@ struct lexer
 
     void advance();
 
-    std::istream& input;
+    /**
+     * @brief Writes a printf-style formatted error or note to the diagnostics stream.
+     */
+    void report(const char* format, ...);
+
+    // The unread portion of the source buffer
+    const char* cursor;
+    const char* end;
+
     ast::file* file;
+    std::ostream& diagnostics;
+
+    // How runs of whitespace, comments and identifiers are skipped; chosen for the CPU when the lexer is created
+    const scan_kernels& scan;
+
     token current_token = token::invalid;
-    std::string string_value;
+
+    // Where the current token starts in the source buffer. Unlike string_value, always points into the buffer.
+    const char* token_begin = nullptr;
+
+    // The text of the current token; a view into the source buffer, so no copy is made per token
+    std::string_view string_value;
 };
@@ -1,86 +1,305 @@
-
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
-#include "parser.h"
-#include "emit/codegen_cpp.h"
-#include "emit/codegen_proto.h"
+#include "ast_cache.h"
+#include "driver.h"
 #include "config.h"
+#include "file_io.h"
+#include "module_graph.h"
+#include "output_cache.h"
+#include "server.h"
+#include "stats.h"
 
 static void print_help(const char* exe_name)
 {
-    std::cout << "Usage: " << exe_name << " <input_file | -> <output_file | -> [config.toml]\n"
-              << "   - indicates stdin for input or stdout for output.\n";
+    std::cout << "Usage: " << exe_name << " [options] <input_file | -> <output_file | -> [config.toml]\n"
+              << "       " << exe_name << " [options] --batch <manifest_file | -> [config.toml]\n"
+              << "       " << exe_name << " [options] --out-cpp <file | -> --out-proto <file | -> <input_file | -> [config.toml]\n"
+              << "       " << exe_name << " --serve | --serve-socket <socket_path>\n"
+              << "       " << exe_name << " [options] --client <socket_path> <input_file> <output_file | -> [config.toml]\n"
+              << "   - indicates stdin for input or stdout for output.\n"
+              << "   A manifest lists one '<input_file> <output_file>' pair per line.\n"
+              << "   --serve answers length-prefixed requests on stdin/stdout; --serve-socket on a Unix socket.\n"
+              << "   --client sends inputs to a server listening on a socket; with --batch, over one connection.\n"
+              << "   --out-cpp and --out-proto parse the input once and generate each output given at the same time,\n"
+              << "   whatever format the config file names. They can't be used with --cache-dir or --pipeline.\n"
+              << "Options:\n"
+              << "   -j N                Convert, or parse imported files, up to N at once; 0 uses every hardware thread.\n"
+              << "                       A single input has its declarations generated on N threads.\n"
+              << "   --cache-dir DIR     Reuse output for inputs converted before with the same settings.\n"
+              << "   --write-if-changed  Leave output files that are already up to date untouched.\n"
+              << "   --watch             Keep running, converting inputs again each time they are saved.\n"
+              << "   --pipeline          Generate output from each file while it's still being parsed, on two threads.\n"
+              << "   --stats             Print per-file phase timings and counts to stderr when done.\n"
+              << "   --stats-json FILE   Write the same measurements to FILE as JSON.\n";
+}
+
+/**
+ * @brief Options given ahead of the positional arguments.
+ */
+struct command_line
+{
+    bool batch = false;
+    bool stats = false;
+    bool write_if_changed = false;
+    bool watch = false;
+    bool pipeline = false;
+    bool serve = false;
+    std::size_t thread_count = 1;
+    std::string cache_dir;
+    std::string stats_json; // Where to write --stats-json
+    std::string serve_socket; // Path to listen on, with --serve-socket
+    std::string client_socket; // Path of the server to send to, with --client
+    std::vector<output_target> outputs; // With --out-cpp and --out-proto, in the order given
+    std::vector<std::string> positional;
+};
+
+static bool parse_thread_count(const std::string& text, std::size_t& count)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    count = static_cast<std::size_t>(std::strtoul(text.c_str(), nullptr, 10));
+    return true;
+}
+
+static bool parse_command_line(int argc, char** argv, command_line& cmd)
+{
+    int i = 1;
+    for (; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--batch") {
+            cmd.batch = true;
+        } else if (arg == "--stats") {
+            cmd.stats = true;
+        } else if (arg == "--write-if-changed") {
+            cmd.write_if_changed = true;
+        } else if (arg == "--watch") {
+            cmd.watch = true;
+        } else if (arg == "--pipeline") {
+            cmd.pipeline = true;
+        } else if (arg == "--serve") {
+            cmd.serve = true;
+        } else if (arg == "--serve-socket") {
+            if (++i == argc) return false;
+            cmd.serve_socket = argv[i];
+        } else if (arg == "--client") {
+            if (++i == argc) return false;
+            cmd.client_socket = argv[i];
+        } else if (arg == "--stats-json") {
+            if (++i == argc) return false;
+            cmd.stats_json = argv[i];
+        } else if (arg == "--out-cpp" || arg == "--out-proto") {
+            if (++i == argc) return false;
+            cmd.outputs.push_back({ arg.substr(6), argv[i] });
+        } else if (arg == "--cache-dir") {
+            if (++i == argc) return false;
+            cmd.cache_dir = argv[i];
+        } else if (arg == "-j") {
+            if (++i == argc || !parse_thread_count(argv[i], cmd.thread_count)) return false;
+        } else if (arg.rfind("-j", 0) == 0) {
+            if (!parse_thread_count(arg.substr(2), cmd.thread_count)) return false;
+        } else {
+            break;
+        }
+    }
+    cmd.positional.assign(argv + i, argv + argc);
+
+    if (cmd.serve || !cmd.serve_socket.empty()) return cmd.positional.empty();
+
+    // Several outputs replace the output file, and are only generated in-process for a single input, from one parse
+    // that is neither cached nor pipelined
+    if (!cmd.outputs.empty() &&
+        (cmd.batch || cmd.watch || !cmd.client_socket.empty() || !cmd.cache_dir.empty() || cmd.pipeline))
+    {
+        return false;
+    }
+    const std::size_t required = (cmd.batch || !cmd.outputs.empty()) ? 1 : 2;
+    return (cmd.positional.size() >= required) && (cmd.positional.size() <= required + 1);
+}
+
+/**
+ * @brief Sends each job's input, with the config text, to a running server over one connection, and writes out the
+ * output it sends back.
+ */
+static int run_client(const command_line& cmd, const std::vector<conversion_job>& jobs, const std::string& config_file)
+{
+    server_request request;
+    if (!config_file.empty() && !read_file(config_file, request.config))
+    {
+        std::cerr << "ERROR: Failed to open config file '" << config_file << "'\n";
+        return 1;
+    }
+
+    server_connection connection;
+    if (!connection.connect(cmd.client_socket, std::cerr)) return 1;
+
+    conversion_settings settings;
+    settings.write_if_changed = cmd.write_if_changed;
+
+    // Once the server has gone, the rest of the jobs fail without trying it again
+    bool connected = true;
+    auto convert = [&](const conversion_job& job, std::ostream& console, std::ostream& diagnostics) {
+        request.name = job.input;
+        if (job.input == "-" || !read_file(job.input, request.source, std::ios::binary))
+        {
+            diagnostics << "ERROR: Failed to open file '" << job.input << "'\n";
+            return false;
+        }
+
+        if (!connected) return false;
+        server_response response;
+        if (!connection.send(request, response, diagnostics))
+        {
+            connected = false;
+            return false;
+        }
+        diagnostics << response.diagnostics;
+        return response.ok && write_output(job, settings, response.output, console, diagnostics);
+    };
+
+    // Reported as a local batch is, one request at a time over the one connection
+    if (!cmd.batch) return convert(jobs.front(), std::cout, std::cerr) ? 0 : 1;
+    return (run_batch(jobs, 1, convert, std::cout, std::cerr) == 0) ? 0 : 1;
 }
 
 int main(int argc, char** argv)
 {
-    if (argc < 3)
+    command_line cmd;
+    if (!parse_command_line(argc, argv, cmd))
     {
         std::cerr << "ERROR: Invalid parameters.\n";
         print_help(argv[0]);
         return 1;
     }
 
-    std::string in_file = argv[1];
-    std::string out_file = argv[2];
+	// Run As Server Or Client
+    if (cmd.serve || !cmd.serve_socket.empty())
+    {
+        generator_server server(cmd.thread_count);
+        return (cmd.serve ? serve_stdio(server) : serve_socket(server, cmd.serve_socket, std::cerr)) ? 0 : 1;
+    }
+
+    const std::size_t config_index = (cmd.batch || !cmd.outputs.empty()) ? 1 : 2;
     std::string config_file;
+    if (cmd.positional.size() > config_index)
+    {
+        config_file = cmd.positional[config_index];
+    }
 
-    if (argc > 3)
+    if (!cmd.client_socket.empty() && !cmd.batch)
     {
-        config_file = argv[3];
+        return run_client(cmd, { { cmd.positional[0], cmd.positional[1] } }, config_file);
     }
 
-    std::string string_format = "cpp";
-    codegen_config conf;
+    conversion_settings settings;
+    settings.write_if_changed = cmd.write_if_changed;
+    settings.pipeline = cmd.pipeline;
+
+    // A batch already keeps every thread busy with whole files
+    settings.generate_threads = cmd.batch ? 1 : cmd.thread_count;
 
 	// Process Config File
-    if (!parse_config(config_file, conf, string_format)) {
+    run_stats stats;
+    const auto config_start = std::chrono::steady_clock::now();
+    if (!parse_config(config_file, settings.config, settings.format)) {
         return 1;
     }
+    stats.config_ms = elapsed_ms(config_start);
+    if (cmd.stats || !cmd.stats_json.empty()) settings.stats = &stats;
 
-	// Open Input Stream
-    std::istream* in_stream = &std::cin;
-    std::ifstream input_file_stream;
-    if (in_file != "-")
+	// Open Output Cache
+    std::unique_ptr<output_cache> cache;
+    std::unique_ptr<ast_cache> asts;
+    if (!cmd.cache_dir.empty())
     {
-        input_file_stream.open(in_file);
-        if (input_file_stream.fail())
+        cache = std::make_unique<output_cache>(cmd.cache_dir, settings_fingerprint(settings));
+        if (!cache->usable())
         {
-            std::cerr << "ERROR: Failed to open file '" << in_file << "'\n";
-            return 1;
+            std::cerr << "WARNING: Failed to create cache directory '" << cmd.cache_dir << "'; not caching\n";
+        }
+        settings.cache = cache.get();
+
+        // Imported files' trees are kept alongside, so a change to an importing file doesn't mean parsing them again
+        asts = std::make_unique<ast_cache>(cmd.cache_dir);
+    }
+
+	// Share Imported Files Between Inputs
+    module_graph modules(cmd.thread_count, asts.get(), cmd.watch);
+    settings.modules = &modules;
+
+    auto print_stats = [&] {
+        if (!settings.stats) return;
+        stats.cache_enabled = (cache != nullptr);
+        if (cache)
+        {
+            stats.cache_hits = cache->hits();
+            stats.cache_misses = cache->misses();
+        }
+        stats.imports_cached = asts ? asts->hits() : 0;
+        stats.imports_parsed = modules.parsed_count() - stats.imports_cached;
+
+        if (cmd.stats) stats.write_text(std::cerr);
+        if (!cmd.stats_json.empty())
+        {
+            std::ofstream json(cmd.stats_json);
+            stats.write_json(json);
+            if (!json) std::cerr << "ERROR: Failed to write stats file '" << cmd.stats_json << "'\n";
         }
-        in_stream = &input_file_stream;
+    };
+
+    if (!cmd.batch && cmd.watch)
+    {
+        return watch_files({ { cmd.positional[0], cmd.positional[1] } }, settings, std::cout, std::cerr) ? 0 : 1;
     }
 
-	// Open Output Stream
-    std::ostream* out_stream = &std::cout;
-    std::ofstream output_file_stream;
-    if (out_file != "-")
+    if (!cmd.outputs.empty())
     {
-        output_file_stream.open(out_file);
-        if (output_file_stream.fail())
+        const bool ok = convert_file_to_outputs(cmd.positional[0], cmd.outputs, settings, std::cout, std::cerr);
+        print_stats();
+        return ok ? 0 : 1;
+    }
+
+    if (!cmd.batch)
+    {
+        const bool ok = convert_file({ cmd.positional[0], cmd.positional[1] }, settings, std::cout, std::cerr);
+        print_stats();
+        return ok ? 0 : 1;
+    }
+
+	// Read Batch Manifest
+    const std::string& manifest_file = cmd.positional[0];
+    std::vector<conversion_job> jobs;
+    if (manifest_file != "-")
+    {
+        std::ifstream manifest(manifest_file);
+        if (manifest.fail())
         {
-            std::cerr << "ERROR: Failed to open output file '" << out_file << "'\n";
+            std::cerr << "ERROR: Failed to open manifest file '" << manifest_file << "'\n";
             return 1;
         }
-        out_stream = &output_file_stream;
+        if (!read_manifest(manifest, jobs, std::cerr)) return 1;
     }
-
-	// Parse Input File
-    auto file = parse_file(*in_stream);
-    if (!file)
+    else if (!read_manifest(std::cin, jobs, std::cerr))
     {
-        std::cerr << "Error encountered while parsing file; aborting\n";
         return 1;
     }
-    if (string_format == "proto") {
-        generate_proto(*out_stream, file.get(), conf);
-    } else {
-        *out_stream << "/* Generated C++ Header from " << (in_file == "-" ? "stdin" : in_file) << " */\n";
-        generate_cpp(*out_stream, file.get(), conf);
+
+    if (!cmd.client_socket.empty())
+    {
+        return run_client(cmd, jobs, config_file);
+    }
+    if (cmd.watch)
+    {
+        return watch_files(jobs, settings, std::cout, std::cerr) ? 0 : 1;
     }
 
-    return 0;
+	// Convert Every File
+    const std::size_t failed = convert_batch(jobs, settings, cmd.thread_count, std::cout, std::cerr);
+    print_stats();
+    return (failed == 0) ? 0 : 1;
 }
@@ -0,0 +1,381 @@
+#include "module_graph.h"
+
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <system_error>
+#include <unordered_set>
+
+#include "ast_cache.h"
+#include "file_io.h"
+#include "parser.h"
+#include "source_buffer.h"
+#include "thread_pool.h"
+
+module_graph::module_graph(std::size_t thread_count, ast_cache* cache, bool reload_changed) :
+    thread_count(thread_count), cache(cache), reload_changed(reload_changed) {}
+
+module_graph::~module_graph() = default;
+
+std::size_t module_graph::parsed_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return parsed;
+}
+
+source_module* module_graph::find_or_add(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    auto absolute = std::filesystem::absolute(path, ec);
+    std::string key = (ec ? path : absolute).lexically_normal().string();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = modules[key];
+    if (!slot)
+    {
+        slot = std::make_unique<source_module>();
+        slot->path = path.lexically_normal().string();
+    }
+    return slot.get();
+}
+
+/**
+ * @brief The files a relative import could refer to, in the order TypeScript tries them.
+ */
+static std::vector<std::filesystem::path> import_candidates(const std::filesystem::path& directory,
+    std::string_view module_name)
+{
+    std::vector<std::filesystem::path> candidates;
+    if (module_name.empty() || (module_name[0] != '.' && module_name[0] != '/')) return candidates;
+
+    auto base = directory / std::filesystem::path(module_name);
+    const auto extension = base.extension();
+    if (extension == ".ts") {
+        candidates.push_back(base);
+        return candidates;
+    }
+    if (extension == ".js") {
+        // Imports written for the compiled output name the .js file
+        candidates.push_back(std::filesystem::path(base).replace_extension(".ts"));
+        candidates.push_back(std::filesystem::path(base).replace_extension(".d.ts"));
+        return candidates;
+    }
+
+    candidates.push_back(base.string() + ".ts");
+    candidates.push_back(base.string() + ".d.ts");
+    candidates.push_back(base / "index.ts");
+    candidates.push_back(base / "index.d.ts");
+    return candidates;
+}
+
+void module_graph::resolve_imports(const ast::file& file, const std::filesystem::path& directory,
+    std::vector<const source_module*>& imports, std::vector<std::string>& missing)
+{
+    for (auto* child : file.children)
+    {
+        auto* imp = ast::node_cast<ast::import_stmt>(child);
+        if (!imp) continue;
+
+        const auto candidates = import_candidates(directory, imp->module_name);
+        bool found = false;
+        for (const auto& candidate : candidates)
+        {
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(candidate, ec))
+            {
+                imports.push_back(find_or_add(candidate));
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            for (const auto& candidate : candidates) missing.push_back(candidate.lexically_normal().string());
+        }
+    }
+}
+
+void module_graph::parse(source_module& module, std::ostream& diagnostics)
+{
+    // Looked at before reading, so that a write made while reading is seen as a change the next time
+    std::error_code ec;
+    module.modified = std::filesystem::last_write_time(module.path, ec);
+    module.size = ec ? 0 : std::filesystem::file_size(module.path, ec);
+
+    // Read rather than mapped: declarations copied out of the file keep viewing its text for as long as the graph
+    // lives, which would break if the file were changed in place while mapped
+    std::ifstream input(module.path, std::ios::binary);
+    auto source = input.fail() ? nullptr : source_buffer::read_stream(input);
+    if (!source)
+    {
+        diagnostics << "ERROR: Failed to open file '" << module.path << "'\n";
+        return;
+    }
+    module.read = true;
+    module.hash = content_hasher().update(source->text()).digest();
+
+    module.file = cache ? cache->parse(std::move(source), diagnostics) : parse_file(std::move(source), diagnostics);
+    if (!module.file)
+    {
+        diagnostics << "WARNING: Declarations in '" << module.path << "' are unavailable to the files importing it\n";
+        return;
+    }
+
+    for (auto* child : module.file->children)
+    {
+        auto id = ast::declared_name(child);
+        if (id != ast::invalid_symbol) module.declarations.emplace(module.file->symbols.name(id), child);
+    }
+
+    resolve_imports(*module.file, std::filesystem::path(module.path).parent_path(), module.imports, module.missing);
+}
+
+/**
+ * @brief Parses every module in the frontier, then every module they import, and so on, skipping modules that are
+ * already parsed and waiting for those another thread is parsing.
+ */
+void module_graph::load_all(std::vector<source_module*> frontier, std::ostream& diagnostics)
+{
+    std::unordered_set<const source_module*> seen(frontier.begin(), frontier.end());
+    while (!frontier.empty())
+    {
+        std::vector<source_module*> claimed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto* module : frontier)
+            {
+                if (module->state != source_module::load_state::unparsed) continue;
+                module->state = source_module::load_state::parsing;
+                claimed.push_back(module);
+            }
+        }
+
+        // Each module's messages are held back, so that parallel parses don't interleave them
+        std::vector<std::ostringstream> messages(claimed.size());
+        if (claimed.size() > 1 && thread_count != 1)
+        {
+            std::call_once(pool_started, [this] { pool = std::make_unique<work_stealing_pool>(thread_count); });
+
+            std::mutex done_mutex;
+            std::condition_variable done;
+            std::size_t remaining = claimed.size();
+            for (std::size_t i = 0; i < claimed.size(); ++i)
+            {
+                pool->submit([&, i] {
+                    parse(*claimed[i], messages[i]);
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    if (--remaining == 0) done.notify_one();
+                });
+            }
+            std::unique_lock<std::mutex> lock(done_mutex);
+            done.wait(lock, [&] { return remaining == 0; });
+        }
+        else
+        {
+            for (std::size_t i = 0; i < claimed.size(); ++i) parse(*claimed[i], messages[i]);
+        }
+        for (auto& m : messages) diagnostics << m.str();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (auto* module : claimed) module->state = source_module::load_state::parsed;
+            parsed += claimed.size();
+            module_parsed.notify_all();
+
+            module_parsed.wait(lock, [&] {
+                for (auto* module : frontier)
+                {
+                    if (module->state != source_module::load_state::parsed) return false;
+                }
+                return true;
+            });
+        }
+
+        std::vector<source_module*> next;
+        for (auto* module : frontier)
+        {
+            for (auto* imported : module->imports)
+            {
+                if (seen.insert(imported).second) next.push_back(const_cast<source_module*>(imported));
+            }
+        }
+        frontier = std::move(next);
+    }
+}
+
+bool module_graph::is_parsed(const source_module* module) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return module->state == source_module::load_state::parsed;
+}
+
+/**
+ * @brief Whether a module's file no longer holds what was parsed, or a file it looked for in vain now exists.
+ *
+ * Only files whose modification time or size differ are read, and then only a change to their text counts.
+ */
+bool module_graph::changed_on_disk(const source_module& module)
+{
+    std::error_code ec;
+    for (const auto& path : module.missing)
+    {
+        if (std::filesystem::is_regular_file(path, ec)) return true;
+    }
+
+    const auto modified = std::filesystem::last_write_time(module.path, ec);
+    if (ec) return module.read;
+    const auto size = std::filesystem::file_size(module.path, ec);
+    if (!ec && module.read && modified == module.modified && size == module.size) return false;
+
+    std::string contents;
+    if (!read_file(module.path, contents, std::ios::binary)) return module.read;
+    return !module.read || content_hasher().update(contents).digest() != module.hash;
+}
+
+/**
+ * @brief Replaces every parsed module reachable from 'roots' whose file has changed, or that imports one that has
+ * been replaced, with an unparsed one.
+ */
+void module_graph::replace_changed(const std::vector<const source_module*>& roots)
+{
+    // Modules still being parsed are reading their files now, and their imports aren't known yet
+    std::vector<const source_module*> loaded;
+    std::unordered_set<const source_module*> seen;
+    auto visit = [&](const source_module* module) {
+        if (seen.insert(module).second && is_parsed(module)) loaded.push_back(module);
+    };
+    for (auto* module : roots) visit(module);
+    for (std::size_t i = 0; i < loaded.size(); ++i)
+    {
+        for (auto* module : loaded[i]->imports) visit(module);
+    }
+
+    std::unordered_set<const source_module*> stale;
+    for (auto* module : loaded)
+    {
+        if (changed_on_disk(*module)) stale.insert(module);
+    }
+    if (stale.empty()) return;
+
+    // A file importing a replaced module must resolve its imports again, to the new one
+    for (bool spreading = true; spreading;)
+    {
+        spreading = false;
+        for (auto* module : loaded)
+        {
+            if (stale.count(module)) continue;
+            for (auto* imported : module->imports)
+            {
+                if (!stale.count(imported)) continue;
+                stale.insert(module);
+                spreading = true;
+                break;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [key, slot] : modules)
+    {
+        if (!stale.count(slot.get())) continue;
+        auto fresh = std::make_unique<source_module>();
+        fresh->path = slot->path;
+        replaced.push_back(std::move(slot));
+        slot = std::move(fresh);
+    }
+}
+
+std::vector<const source_module*> module_graph::load_imports(const ast::file& file,
+    const std::filesystem::path& directory, std::vector<std::string>& missing, std::ostream& diagnostics)
+{
+    if (reload_changed)
+    {
+        std::vector<const source_module*> loaded;
+        std::vector<std::string> ignored;
+        resolve_imports(file, directory, loaded, ignored);
+        replace_changed(loaded);
+    }
+
+    std::vector<const source_module*> imports;
+    resolve_imports(file, directory, imports, missing);
+
+    std::vector<source_module*> frontier;
+    for (auto* module : imports) frontier.push_back(const_cast<source_module*>(module));
+    load_all(std::move(frontier), diagnostics);
+    return imports;
+}
+
+std::vector<const source_module*> module_graph::reachable(const std::vector<const source_module*>& imports)
+{
+    std::vector<const source_module*> result;
+    std::unordered_set<const source_module*> seen;
+    for (auto* module : imports)
+    {
+        if (seen.insert(module).second) result.push_back(module);
+    }
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        for (auto* module : result[i]->imports)
+        {
+            if (seen.insert(module).second) result.push_back(module);
+        }
+    }
+    return result;
+}
+
+void module_graph::link(ast::file& file, const std::vector<const source_module*>& imports,
+    const std::vector<ast::symbol_id>* references)
+{
+    if (imports.empty()) return;
+    const auto modules = reachable(imports);
+
+    // Names that already resolve within the file, or that have been looked up already
+    std::unordered_set<ast::symbol_id> resolved;
+    for (auto* child : file.children) resolved.insert(ast::declared_name(child));
+    for (auto* decl : file.imported) resolved.insert(ast::declared_name(decl));
+
+    std::vector<ast::symbol_id> pending;
+    if (references) {
+        pending = *references;
+    } else {
+        for (auto* child : file.children) ast::collect_references(child, pending);
+    }
+
+    while (!pending.empty())
+    {
+        const auto id = pending.back();
+        pending.pop_back();
+        if (id < ast::builtin::count || !resolved.insert(id).second) continue;
+
+        const auto name = file.symbols.name(id);
+        for (auto* module : modules)
+        {
+            auto it = module->declarations.find(name);
+            if (it == module->declarations.end()) continue;
+
+            auto* copy = ast::clone(file, it->second);
+            copy->parent = &file;
+            file.imported.push_back(copy);
+            ast::collect_references(copy, pending);
+            break;
+        }
+    }
+}
+
+std::vector<cache_dependency> module_graph::dependencies(const std::vector<const source_module*>& imports,
+    const std::vector<std::string>& missing, const std::filesystem::path& base)
+{
+    auto relative = [&](const std::string& path) {
+        auto result = std::filesystem::path(path).lexically_relative(base);
+        return result.empty() ? path : result.string();
+    };
+
+    std::vector<cache_dependency> result;
+    for (const auto& path : missing) result.push_back({ relative(path), false, {} });
+    for (auto* module : reachable(imports))
+    {
+        result.push_back({ relative(module->path), module->file != nullptr, module->text() });
+        for (const auto& path : module->missing) result.push_back({ relative(path), false, {} });
+    }
+    return result;
+}
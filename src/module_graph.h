@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "output_cache.h"
+
+class ast_cache;
+class work_stealing_pool;
+
+/**
+ * @brief A TypeScript file loaded because it was converted or imported, along with the files it imports.
+ */
+class source_module
+{
+public:
+    std::string path;
+
+    // nullptr if the file couldn't be read or parsed
+    std::unique_ptr<ast::file> file;
+
+    // The modules its import statements resolved to, in the order they're imported
+    std::vector<const source_module*> imports;
+
+    // Paths tried for relative imports that didn't resolve; creating one of them would change the output
+    std::vector<std::string> missing;
+
+    // Top-level interfaces, type aliases and enums by name
+    std::unordered_map<std::string_view, const ast::node*> declarations;
+
+    std::string_view text() const noexcept { return (file && file->source) ? file->source->text() : std::string_view(); }
+
+private:
+    friend class module_graph;
+
+    enum class load_state { unparsed, parsing, parsed };
+    load_state state = load_state::unparsed;
+
+    // The file as it was read, so that a graph reloading changed files can tell whether it has changed since
+    bool read = false;
+    std::filesystem::file_time_type modified{};
+    std::uintmax_t size = 0;
+    content_hash hash;
+};
+
+/**
+ * @brief Every file loaded in a run, so that a file imported by several others is only parsed once.
+ *
+ * Imports are resolved like TypeScript resolves relative imports: "./name" is looked for as name.ts, name.d.ts,
+ * name/index.ts and name/index.d.ts next to the importing file. Imports of packages are left unresolved. Safe to use
+ * from several threads at once.
+ *
+ * A loaded module is never changed. In a graph that reloads changed files, a module whose file has changed, or that
+ * imports one that has, is replaced by a new one, so that files importing it resolve to the new one while anything
+ * still using the old one can carry on. Replaced modules are kept for as long as the graph lives, as declarations
+ * linked from them view their text.
+ */
+class module_graph
+{
+public:
+    /**
+     * @param thread_count The number of files parsed at once; zero uses one per hardware thread.
+     * @param cache Optional; when set, imported files parsed before are loaded from it rather than parsed again.
+     * @param reload_changed True for a process that outlives edits to the files, such as a watcher or a server: files
+     * loaded before are checked each time they're imported again, and parsed again if their contents have changed.
+     */
+    explicit module_graph(std::size_t thread_count, ast_cache* cache = nullptr, bool reload_changed = false);
+    ~module_graph();
+
+    module_graph(const module_graph&) = delete;
+    module_graph& operator=(const module_graph&) = delete;
+
+    /**
+     * @brief Loads every file a file imports, directly or indirectly.
+     *
+     * Files imported by the same file are parsed in parallel. A file another thread is already parsing is waited for
+     * rather than parsed again; one that couldn't be read or parsed has a null 'file'.
+     *
+     * @param directory What relative imports are relative to.
+     * @param missing Receives the paths tried for imports that didn't resolve.
+     */
+    std::vector<const source_module*> load_imports(const ast::file& file, const std::filesystem::path& directory,
+        std::vector<std::string>& missing, std::ostream& diagnostics);
+
+    /**
+     * @brief Copies into 'file' the imported declarations that it refers to, and any those refer to in turn.
+     *
+     * A name is looked up in the directly imported files first, then in what they import, and so on. Names declared in
+     * the file itself, or already copied into it, are left alone, so linking again after an edit only copies what the
+     * edit started referring to.
+     *
+     * @param references The names to resolve; everything in the file if null.
+     */
+    static void link(ast::file& file, const std::vector<const source_module*>& imports,
+        const std::vector<ast::symbol_id>* references = nullptr);
+
+    /**
+     * @brief Every file, besides the converted one, that output generated with these imports depends on.
+     *
+     * @param missing Paths tried for the converted file's own unresolved imports.
+     * @param base The converted file's directory, which the returned paths are made relative to so that the same text
+     * elsewhere doesn't pick up this file's dependencies.
+     */
+    static std::vector<cache_dependency> dependencies(const std::vector<const source_module*>& imports,
+        const std::vector<std::string>& missing, const std::filesystem::path& base);
+
+    /**
+     * @brief Every module reachable through the given loaded imports, nearest first.
+     */
+    static std::vector<const source_module*> reachable(const std::vector<const source_module*>& imports);
+
+    /**
+     * @brief The number of files parsed so far.
+     */
+    std::size_t parsed_count() const;
+
+private:
+    source_module* find_or_add(const std::filesystem::path& path);
+    void resolve_imports(const ast::file& file, const std::filesystem::path& directory,
+        std::vector<const source_module*>& imports, std::vector<std::string>& missing);
+    void parse(source_module& module, std::ostream& diagnostics);
+    void load_all(std::vector<source_module*> frontier, std::ostream& diagnostics);
+    bool is_parsed(const source_module* module) const;
+    static bool changed_on_disk(const source_module& module);
+    void replace_changed(const std::vector<const source_module*>& roots);
+
+    const std::size_t thread_count;
+    ast_cache* const cache;
+    const bool reload_changed;
+    std::unique_ptr<work_stealing_pool> pool;
+    std::once_flag pool_started;
+
+    mutable std::mutex mutex;
+    std::condition_variable module_parsed;
+    std::unordered_map<std::string, std::unique_ptr<source_module>> modules;
+    std::vector<std::unique_ptr<source_module>> replaced;
+    std::size_t parsed = 0;
+};
@@ -0,0 +1,155 @@
+#include "output_cache.h"
+
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#include "file_io.h"
+
+std::string content_hash::hex() const
+{
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string result(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        result[15 - i] = digits[(high >> (i * 4)) & 0xf];
+        result[31 - i] = digits[(low >> (i * 4)) & 0xf];
+    }
+    return result;
+}
+
+content_hasher& content_hasher::update(std::string_view bytes) noexcept
+{
+    // Eight bytes at a time, as whole source files are hashed to look them up. Words are read in the machine's byte
+    // order, so digests differ between little- and big-endian machines, which only costs a shared cache its hits.
+    const char* data = bytes.data();
+    std::size_t remaining = bytes.size();
+    for (; remaining >= sizeof(std::uint64_t); data += sizeof(std::uint64_t), remaining -= sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        fnv = (fnv ^ word) * 0x9e3779b97f4a7c15ull;
+        fnv ^= fnv >> 32;
+        mix = (mix ^ word) * 0xff51afd7ed558ccdull;
+        mix ^= mix >> 29;
+    }
+    for (; remaining > 0; ++data, --remaining)
+    {
+        const auto ch = static_cast<unsigned char>(*data);
+        fnv = (fnv ^ ch) * 0x100000001b3ull;
+        mix = ((mix ^ ch) * 0xff51afd7ed558ccdull);
+        mix ^= mix >> 29;
+    }
+    length += bytes.size();
+
+    // Separates consecutive ranges, so that ("ab", "c") and ("a", "bc") hash differently
+    fnv = (fnv ^ 0xff) * 0x100000001b3ull;
+    return *this;
+}
+
+static std::uint64_t finalize(std::uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+content_hash content_hasher::digest() const noexcept
+{
+    return { finalize(fnv), finalize(mix ^ length) };
+}
+
+output_cache::output_cache(std::filesystem::path directory, std::string fingerprint) :
+    directory(std::move(directory)),
+    fingerprint(std::move(fingerprint))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(this->directory, ec);
+    is_usable = std::filesystem::is_directory(this->directory, ec);
+}
+
+// Changed whenever the layout of an entry changes, so that older entries are never misread
+static constexpr std::string_view entry_format = "entry-format 2\n";
+
+// Recorded in place of a hash for a dependency that didn't exist
+static constexpr std::string_view missing_file = "missing";
+
+std::filesystem::path output_cache::entry_path(std::string_view source) const
+{
+    auto hash = content_hasher().update(entry_format).update(fingerprint).update(source).digest();
+    return directory / (hash.hex() + ".out");
+}
+
+/**
+ * @brief Checks the dependency list at the start of an entry, and removes it to leave just the output.
+ *
+ * An entry starts with the number of dependencies on its own line, followed by a line for each with the hash of its
+ * contents (or "missing") and its path.
+ *
+ * @param base What relative dependency paths are relative to.
+ * @return False if the entry is malformed or any dependency has changed.
+ */
+static bool check_dependencies(std::string& entry, const std::filesystem::path& base)
+{
+    std::size_t pos = entry.find('\n');
+    if (pos == std::string::npos) return false;
+    const std::string count_text = entry.substr(0, pos);
+    if (count_text.empty() || count_text.find_first_not_of("0123456789") != std::string::npos) return false;
+    std::size_t count = std::stoul(count_text);
+    ++pos;
+
+    std::string contents;
+    for (; count > 0; --count)
+    {
+        const std::size_t end = entry.find('\n', pos);
+        const std::size_t space = entry.find(' ', pos);
+        if (end == std::string::npos || space == std::string::npos || space > end) return false;
+
+        const std::string_view recorded(entry.data() + pos, space - pos);
+        const auto path = base / entry.substr(space + 1, end - space - 1);
+        if (read_file(path, contents, std::ios::binary)) {
+            if (recorded != content_hasher().update(contents).digest().hex()) return false;
+        } else if (recorded != missing_file) {
+            return false;
+        }
+        pos = end + 1;
+    }
+
+    entry.erase(0, pos);
+    return true;
+}
+
+bool output_cache::load(std::string_view source, std::string& output, const std::filesystem::path& base)
+{
+    if (is_usable && read_file(entry_path(source), output, std::ios::binary) && check_dependencies(output, base))
+    {
+        ++hit_count;
+        return true;
+    }
+    ++miss_count;
+    return false;
+}
+
+void output_cache::store(std::string_view source, std::string_view output,
+    const std::vector<cache_dependency>& dependencies)
+{
+    if (!is_usable) return;
+
+    std::string entry = std::to_string(dependencies.size()) + "\n";
+    for (const auto& dependency : dependencies)
+    {
+        if (dependency.exists) {
+            entry += content_hasher().update(dependency.contents).digest().hex();
+        } else {
+            entry += missing_file;
+        }
+        entry += ' ';
+        entry += dependency.path;
+        entry += '\n';
+    }
+    entry += output;
+    replace_file(entry_path(source), entry, std::ios::binary);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A 128-bit digest of some content, used to name cache entries.
+ */
+struct content_hash
+{
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+
+    std::string hex() const;
+
+    bool operator==(const content_hash& other) const noexcept { return high == other.high && low == other.low; }
+    bool operator!=(const content_hash& other) const noexcept { return !(*this == other); }
+};
+
+/**
+ * @brief Incrementally hashes a sequence of byte ranges. Not cryptographic; only meant to tell inputs apart.
+ */
+class content_hasher
+{
+public:
+    content_hasher& update(std::string_view bytes) noexcept;
+    content_hash digest() const noexcept;
+
+private:
+    std::uint64_t fnv = 0xcbf29ce484222325ull;
+    std::uint64_t mix = 0x9e3779b97f4a7c15ull;
+    std::uint64_t length = 0;
+};
+
+/**
+ * @brief A file besides the input that generated output depends on, such as an imported module.
+ */
+struct cache_dependency
+{
+    std::string path;          /*!< Relative to the base the entry is looked up with */
+    bool exists = false;
+    std::string_view contents; /*!< Unused if the file doesn't exist, in which case creating it invalidates the entry */
+};
+
+/**
+ * @brief Generated output stored on disk, keyed by a hash of the input text and everything else the output depends on.
+ *
+ * Entries are written to a temporary file and renamed into place, so several processes or threads can share one
+ * directory. Safe to use from several threads at once.
+ */
+class output_cache
+{
+public:
+    /**
+     * @param directory Where entries are stored; created if it doesn't exist.
+     * @param fingerprint Everything besides the input text that affects the output (tool version, format, config).
+     */
+    output_cache(std::filesystem::path directory, std::string fingerprint);
+
+    /**
+     * @brief Returns false if the cache directory couldn't be created, in which case every lookup misses.
+     */
+    bool usable() const noexcept { return is_usable; }
+
+    /**
+     * @brief Looks up the output previously stored for the given input.
+     *
+     * An entry only counts as a hit if every file it was stored with a dependency on is still as it was.
+     *
+     * @param base What the relative dependency paths the entry was stored with are relative to.
+     * @return True on a hit, with the stored output in 'output'.
+     */
+    bool load(std::string_view source, std::string& output, const std::filesystem::path& base = {});
+
+    /**
+     * @brief Stores the output generated for the given input. Failures are ignored; the entry is simply missing later.
+     */
+    void store(std::string_view source, std::string_view output, const std::vector<cache_dependency>& dependencies = {});
+
+    std::size_t hits() const noexcept { return hit_count; }
+    std::size_t misses() const noexcept { return miss_count; }
+
+private:
+    std::filesystem::path entry_path(std::string_view source) const;
+
+    std::filesystem::path directory;
+    std::string fingerprint;
+    bool is_usable = false;
+
+    std::atomic<std::size_t> hit_count{ 0 };
+    std::atomic<std::size_t> miss_count{ 0 };
+};
@@ -1,8 +1,10 @@
 
 #include <cassert>
+#include <ostream>
 
 #include "lexer.h"
 #include "parser.h"
+#include "source_buffer.h"
 
 using namespace std::literals;
 
@@ -14,6 +16,40 @@ static ast::type_alias* parse_type_alias(lexer& lex);
 static ast::import_stmt* parse_import(lexer& lex);
 static ast::enumeration* parse_enum(lexer& lex);
 
+// Most keywords are contextual, so they can still appear wherever a plain name is expected
+static bool is_name_token(token tok)
+{
+    switch (tok)
+    {
+    case token::identifier:
+    case token::keyword_export:
+    case token::keyword_module:
+    case token::keyword_interface:
+    case token::keyword_extends:
+    case token::keyword_type:
+    case token::keyword_keyof:
+    case token::keyword_in:
+    case token::keyword_unknown:
+    case token::keyword_never:
+    case token::keyword_import:
+    case token::keyword_from:
+    case token::keyword_enum:
+    case token::keyword_declare:
+    case token::keyword_readonly:
+    case token::keyword_null:
+    case token::keyword_undefined:
+    case token::keyword_typeof:
+    case token::type_any:
+    case token::type_boolean:
+    case token::type_string:
+    case token::type_number:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
 static ast::module* parse_module(lexer& lex)
 {
     assert(lex.current_token == token::keyword_module);
@@ -21,17 +57,17 @@ static ast::module* parse_module(lexer& lex)
 
     if (lex.current_token != token::identifier)
     {
-        std::printf("ERROR: Unexpected token '%s' for name of module; expected an identifier\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' for name of module; expected an identifier\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
-    auto result = std::make_unique<ast::module>();
-    result->name.swap(lex.string_value);
+    auto result = lex.file->make<ast::module>();
+    result->name = lex.string_value;
 
     lex.advance();
     if (lex.current_token != token::open_curly)
     {
-        std::printf("ERROR: Unexpected token '%s' after declaration of module '%s'; expected an '{'\n", lex.string_value.c_str(), result->name.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' after declaration of module '%.*s'; expected an '{'\n", SV_ARG(lex.string_value), SV_ARG(result->name));
         return nullptr;
     }
 
@@ -45,24 +81,22 @@ static ast::module* parse_module(lexer& lex)
             auto ptr = parse_export(lex);
             if (!ptr)
             {
-                std::printf("NOTE: While processing module '%s'\n", result->name.c_str());
+                lex.report("NOTE: While processing module '%.*s'\n", SV_ARG(result->name));
                 return nullptr;
             }
-            ptr->parent = result.get();
-            result->children.push_back(std::move(ptr));
+            ptr->parent = result;
+            result->children.push_back(ptr);
         }   break;
 
         default:
-            std::printf("ERROR: Unexpected token '%s' while parsing module '%s' body\n", lex.string_value.c_str(), result->name.c_str());
+            lex.report("ERROR: Unexpected token '%.*s' while parsing module '%.*s' body\n", SV_ARG(lex.string_value), SV_ARG(result->name));
             return nullptr;
         }
     }
 
     lex.advance(); // Consume the '}'
 
-    auto resultPtr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return resultPtr;
+    return result;
 }
 
 static ast::node* parse_single_type(lexer& lex)
@@ -71,45 +105,38 @@ static ast::node* parse_single_type(lexer& lex)
     switch (lex.current_token)
     {
     case token::type_string:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::string);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::string);
         lex.advance();
         break;
     case token::type_boolean:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::boolean);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::boolean);
         lex.advance();
         break;
     case token::type_number:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::number);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::number);
         lex.advance();
         break;
     case token::type_any:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::any);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::any);
         lex.advance();
         break;
     case token::keyword_unknown:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::unknown);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::unknown);
         lex.advance();
         break;
     case token::keyword_never:
-        result = new ast::fundamental_type_reference(ast::fundamental_type::never);
-        lex.file->nodes.emplace_back(result);
+        result = lex.file->make<ast::fundamental_type_reference>(ast::fundamental_type::never);
         lex.advance();
         break;
     case token::string:
     case token::number_literal:
     case token::backtick:
     {
-        auto lit = std::make_unique<ast::literal_type>();
+        auto lit = lex.file->make<ast::literal_type>();
         lit->value = lex.string_value;
         lit->is_string = (lex.current_token == token::string) || (lex.current_token == token::backtick);
         lit->is_number = (lex.current_token == token::number_literal);
-        result = lit.get();
-        lex.file->nodes.push_back(std::move(lit));
+        result = lit;
         lex.advance();
         break;
     }
@@ -121,7 +148,7 @@ static ast::node* parse_single_type(lexer& lex)
     case token::open_bracket:
     {
         lex.advance();
-        auto tup = std::make_unique<ast::tuple_type>();
+        auto tup = lex.file->make<ast::tuple_type>();
         while (lex.current_token != token::close_bracket && lex.current_token != token::eof)
         {
             if (lex.current_token == token::dot)
@@ -133,7 +160,6 @@ static ast::node* parse_single_type(lexer& lex)
 
             if (lex.current_token == token::identifier)
             {
-                std::string peek = lex.string_value;
                 lex.advance();
                 if (lex.current_token == token::colon)
                 {
@@ -146,11 +172,14 @@ static ast::node* parse_single_type(lexer& lex)
             }
 
             ast::node* elem_type = parse_type_reference(lex);
-            if (elem_type)
+            if (!elem_type)
             {
-                elem_type->parent = tup.get();
-                tup->elements.push_back(elem_type);
+                // Nothing was consumed, so carrying on would never reach the closing ']'
+                lex.report("NOTE: While processing tuple\n");
+                return nullptr;
             }
+            elem_type->parent = tup;
+            tup->elements.push_back(elem_type);
 
             if (lex.current_token == token::comma)
             {
@@ -158,18 +187,32 @@ static ast::node* parse_single_type(lexer& lex)
             }
         }
         if (lex.current_token == token::close_bracket) lex.advance();
-        result = tup.get();
-        lex.file->nodes.push_back(std::move(tup));
+        result = tup;
+        break;
+    }
+    case token::keyword_typeof:
+    {
+        // Type queries can't be resolved without a type checker; keep the operator as the name so that emitters treat
+        // it like any other unsupported utility type
+        auto ref = lex.file->make<ast::generic_type_reference>();
+        ref->name = lex.string_value;
+        ref->name_id = lex.file->symbols.intern(ref->name);
+        result = ref;
+
+        // Consume the queried expression, e.g. 'typeof config.defaults'
+        lex.advance();
+        while (is_name_token(lex.current_token) || lex.current_token == token::dot) lex.advance();
         break;
     }
     case token::identifier:
     case token::keyword_keyof:
+    case token::keyword_null:
+    case token::keyword_undefined:
     {
-        auto ref = std::make_unique<ast::generic_type_reference>();
-        ref->name.swap(lex.string_value);
-        result = ref.get();
-        auto refPtr = ref.get();
-        lex.file->nodes.push_back(std::move(ref));
+        auto ref = lex.file->make<ast::generic_type_reference>();
+        ref->name = lex.string_value;
+        ref->name_id = lex.file->symbols.intern(ref->name);
+        result = ref;
         lex.advance();
 
         if (lex.current_token == token::less_than)
@@ -178,10 +221,13 @@ static ast::node* parse_single_type(lexer& lex)
             while (lex.current_token != token::greater_than && lex.current_token != token::eof)
             {
                 ast::node* arg = parse_type_reference(lex);
-                if (arg) {
-                    arg->parent = refPtr;
-                    refPtr->arguments.push_back(arg);
+                if (!arg)
+                {
+                    lex.report("NOTE: While processing type arguments of '%.*s'\n", SV_ARG(ref->name));
+                    return nullptr;
                 }
+                arg->parent = ref;
+                ref->arguments.push_back(arg);
                 if (lex.current_token == token::comma) lex.advance();
             }
             if (lex.current_token == token::greater_than) lex.advance();
@@ -196,7 +242,7 @@ static ast::node* parse_single_type(lexer& lex)
         break;
     }
     default:
-        std::printf("ERROR: Unexpected token '%s' while parsing type\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' while parsing type\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
@@ -206,11 +252,10 @@ static ast::node* parse_single_type(lexer& lex)
         if (lex.current_token == token::close_bracket)
         {
             lex.advance();
-            auto arr = std::make_unique<ast::array>();
+            auto arr = lex.file->make<ast::array>();
             arr->type = result;
-            result->parent = arr.get();
-            result = arr.get();
-            lex.file->nodes.push_back(std::move(arr));
+            result->parent = arr;
+            result = arr;
         }
         else
         {
@@ -227,10 +272,9 @@ static ast::node* parse_single_type(lexer& lex)
         while (lex.current_token != token::colon && lex.current_token != token::eof) lex.advance();
         if (lex.current_token == token::colon) lex.advance();
         parse_single_type(lex);
-        auto cond = std::make_unique<ast::conditional_type>();
+        auto cond = lex.file->make<ast::conditional_type>();
         cond->condition = result;
-        result = cond.get();
-        lex.file->nodes.push_back(std::move(cond));
+        result = cond;
     }
 
     return result;
@@ -238,37 +282,32 @@ static ast::node* parse_single_type(lexer& lex)
 
 static ast::node* parse_type_reference(lexer& lex)
 {
-    std::vector<ast::node*> types;
-    types.push_back(parse_single_type(lex));
+    auto first = parse_single_type(lex);
 
     if (lex.current_token == token::pipe)
     {
+        auto un = lex.file->make<ast::union_type>();
+        un->types.push_back(first);
         while (lex.current_token == token::pipe)
         {
             lex.advance();
-            types.push_back(parse_single_type(lex));
+            un->types.push_back(parse_single_type(lex));
         }
-        auto un = std::make_unique<ast::union_type>();
-        un->types = types;
-        ast::node* result = un.get();
-        lex.file->nodes.push_back(std::move(un));
-        return result;
+        return un;
     }
     else if (lex.current_token == token::ampersand)
     {
+        auto in = lex.file->make<ast::intersection_type>();
+        in->types.push_back(first);
         while (lex.current_token == token::ampersand)
         {
             lex.advance();
-            types.push_back(parse_single_type(lex));
+            in->types.push_back(parse_single_type(lex));
         }
-        auto in = std::make_unique<ast::intersection_type>();
-        in->types = types;
-        ast::node* result = in.get();
-        lex.file->nodes.push_back(std::move(in));
-        return result;
+        return in;
     }
 
-    return types[0];
+    return first;
 }
 
 static ast::type_alias* parse_type_alias(lexer& lex)
@@ -278,12 +317,13 @@ static ast::type_alias* parse_type_alias(lexer& lex)
 
     if (lex.current_token != token::identifier)
     {
-        std::printf("ERROR: Unexpected token '%s' for name of type alias; expected an identifier\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' for name of type alias; expected an identifier\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
-    auto result = std::make_unique<ast::type_alias>();
-    result->name.swap(lex.string_value);
+    auto result = lex.file->make<ast::type_alias>();
+    result->name = lex.string_value;
+    result->name_id = lex.file->symbols.intern(result->name);
 
     lex.advance();
 
@@ -295,7 +335,7 @@ static ast::type_alias* parse_type_alias(lexer& lex)
 
     if (lex.current_token != token::equals)
     {
-        std::printf("ERROR: Unexpected token '%s' after declaration of type alias '%s'; expected '='\n", lex.string_value.c_str(), result->name.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' after declaration of type alias '%.*s'; expected '='\n", SV_ARG(lex.string_value), SV_ARG(result->name));
         return nullptr;
     }
 
@@ -304,21 +344,19 @@ static ast::type_alias* parse_type_alias(lexer& lex)
     result->target_type = parse_type_reference(lex);
     if (!result->target_type)
     {
-        std::printf("NOTE: While processing type alias '%s'\n", result->name.c_str());
+        lex.report("NOTE: While processing type alias '%.*s'\n", SV_ARG(result->name));
         return nullptr;
     }
-    result->target_type->parent = result.get();
+    result->target_type->parent = result;
 
     if (lex.current_token != token::semicolon)
     {
-        std::printf("ERROR: Unexpected token '%s' after type alias '%s'; expected ';'\n", lex.string_value.c_str(), result->name.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' after type alias '%.*s'; expected ';'\n", SV_ARG(lex.string_value), SV_ARG(result->name));
         return nullptr;
     }
     lex.advance();
 
-    auto resultPtr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return resultPtr;
+    return result;
 }
 
 static ast::object* parse_object(lexer& lex)
@@ -326,7 +364,7 @@ static ast::object* parse_object(lexer& lex)
     assert(lex.current_token == token::open_curly);
     lex.advance(); // Consume the '{'
 
-    auto result = std::make_unique<ast::object>();
+    auto result = lex.file->make<ast::object>();
     while (lex.current_token != token::close_curly)
     {
         switch (lex.current_token)
@@ -334,11 +372,11 @@ static ast::object* parse_object(lexer& lex)
         case token::open_bracket:
         {
             lex.advance();
-            auto member = std::make_unique<ast::member>();
+            auto member = lex.file->make<ast::member>();
 
             if (lex.current_token == token::identifier)
             {
-                member->name.swap(lex.string_value);
+                member->name = lex.string_value;
                 lex.advance();
             }
 
@@ -367,7 +405,7 @@ static ast::object* parse_object(lexer& lex)
 
             if (lex.current_token != token::colon)
             {
-                std::printf("ERROR: Unexpected token '%s' while parsing object member '%s'; expected ':'\n", lex.string_value.c_str(), member->name.c_str());
+                lex.report("ERROR: Unexpected token '%.*s' while parsing object member '%.*s'; expected ':'\n", SV_ARG(lex.string_value), SV_ARG(member->name));
                 return nullptr;
             }
             lex.advance();
@@ -375,21 +413,19 @@ static ast::object* parse_object(lexer& lex)
             ast::node* type = parse_type_reference(lex);
             if (!type)
             {
-                std::printf("NOTE: While processing object member '%s'\n", member->name.c_str());
+                lex.report("NOTE: While processing object member '%.*s'\n", SV_ARG(member->name));
                 return nullptr;
             }
 
             member->type = type;
-            type->parent = member.get();
+            type->parent = member;
 
             if (lex.current_token == token::semicolon || lex.current_token == token::comma)
             {
                 lex.advance();
             }
 
-            auto memberPtr = member.get();
-            lex.file->nodes.push_back(std::move(member));
-            result->named_members.push_back(memberPtr);
+            result->named_members.push_back(member);
             break;
         }
         case token::keyword_module: // Allowed as an identifier in certain contexts
@@ -398,12 +434,29 @@ static ast::object* parse_object(lexer& lex)
         case token::keyword_in:
         case token::keyword_unknown:
         case token::keyword_never:
+        case token::keyword_declare:
+        case token::keyword_readonly:
+        case token::keyword_null:
+        case token::keyword_undefined:
+        case token::keyword_typeof:
         case token::identifier:
         case token::string:
         case token::number_literal:
         {
-            auto member = std::make_unique<ast::member>();
-            member->name.swap(lex.string_value);
+            if (lex.current_token == token::keyword_readonly)
+            {
+                // 'readonly' is a modifier unless it is the member's name; as a modifier it has no effect on output
+                auto next = lex;
+                next.advance();
+                if (next.current_token != token::colon && next.current_token != token::question)
+                {
+                    lex.advance();
+                    break;
+                }
+            }
+
+            auto member = lex.file->make<ast::member>();
+            member->name = lex.string_value;
             lex.advance();
 
             if (lex.current_token == token::question)
@@ -414,7 +467,7 @@ static ast::object* parse_object(lexer& lex)
 
             if (lex.current_token != token::colon)
             {
-                std::printf("ERROR: Unexpected token '%s' while parsing object member '%s'; expected ':'\n", lex.string_value.c_str(), member->name.c_str());
+                lex.report("ERROR: Unexpected token '%.*s' while parsing object member '%.*s'; expected ':'\n", SV_ARG(lex.string_value), SV_ARG(member->name));
                 return nullptr;
             }
             lex.advance();
@@ -422,22 +475,21 @@ static ast::object* parse_object(lexer& lex)
             ast::node* type = parse_type_reference(lex);
             if (!type)
             {
-                std::printf("NOTE: While processing object member '%s'\n", member->name.c_str());
+                lex.report("NOTE: While processing object member '%.*s'\n", SV_ARG(member->name));
                 return nullptr;
             }
 
             if (lex.current_token == token::open_bracket)
             {
-                auto arr = std::make_unique<ast::array>();
+                auto arr = lex.file->make<ast::array>();
                 arr->type = type;
-                type->parent = arr.get();
-                type = arr.get();
-                lex.file->nodes.push_back(std::move(arr));
+                type->parent = arr;
+                type = arr;
 
                 lex.advance();
                 if (lex.current_token != token::close_bracket)
                 {
-                    std::printf("ERROR: Unexpected token '%s' while parsing object member '%s'; expected ']'\n", lex.string_value.c_str(), member->name.c_str());
+                    lex.report("ERROR: Unexpected token '%.*s' while parsing object member '%.*s'; expected ']'\n", SV_ARG(lex.string_value), SV_ARG(member->name));
                     return nullptr;
                 }
                 lex.advance();
@@ -449,29 +501,25 @@ static ast::object* parse_object(lexer& lex)
             }
             else if (lex.current_token != token::close_curly)
             {
-                std::printf("ERROR: Unexpected token '%s' while parsing object member '%s'; expected ';', ',', or '}'\n", lex.string_value.c_str(), member->name.c_str());
+                lex.report("ERROR: Unexpected token '%.*s' while parsing object member '%.*s'; expected ';', ',', or '}'\n", SV_ARG(lex.string_value), SV_ARG(member->name));
                 return nullptr;
             }
 
             member->type = type;
-            type->parent = member.get();
+            type->parent = member;
 
-            auto memberPtr = member.get();
-            lex.file->nodes.push_back(std::move(member));
-            result->named_members.push_back(memberPtr);
+            result->named_members.push_back(member);
         }   break;
 
         default:
-            std::printf("ERROR: Unexpected token '%s' while parsing object body\n", lex.string_value.c_str());
+            lex.report("ERROR: Unexpected token '%.*s' while parsing object body\n", SV_ARG(lex.string_value));
             return nullptr;
         }
     }
 
     lex.advance(); // Consume the '}'
 
-    auto resultPtr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return resultPtr;
+    return result;
 }
 
 static ast::interface* parse_interface(lexer& lex)
@@ -481,12 +529,13 @@ static ast::interface* parse_interface(lexer& lex)
 
     if (lex.current_token != token::identifier)
     {
-        std::printf("ERROR: Unexpected token '%s' for name of interface; expected an identifier\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' for name of interface; expected an identifier\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
-    auto result = std::make_unique<ast::interface>();
-    result->name.swap(lex.string_value);
+    auto result = lex.file->make<ast::interface>();
+    result->name = lex.string_value;
+    result->name_id = lex.file->symbols.intern(result->name);
 
     lex.advance();
     if (lex.current_token == token::keyword_extends)
@@ -496,14 +545,14 @@ static ast::interface* parse_interface(lexer& lex)
         {
             if (lex.current_token != token::identifier)
             {
-                std::printf("ERROR: Unexpected token '%s' while parsing 'extends' type for interface '%s'; expected an identifier\n", lex.string_value.c_str(), result->name.c_str());
+                lex.report("ERROR: Unexpected token '%.*s' while parsing 'extends' type for interface '%.*s'; expected an identifier\n", SV_ARG(lex.string_value), SV_ARG(result->name));
                 return nullptr;
             }
 
-            auto baseRef = std::make_unique<ast::interface_reference>();
-            baseRef->name.swap(lex.string_value);
-            result->base.push_back(baseRef.get());
-            lex.file->nodes.push_back(std::move(baseRef));
+            auto baseRef = lex.file->make<ast::interface_reference>();
+            baseRef->name = lex.string_value;
+            baseRef->name_id = lex.file->symbols.intern(baseRef->name);
+            result->base.push_back(baseRef);
             lex.advance();
 
             if (lex.current_token == token::comma)
@@ -519,27 +568,29 @@ static ast::interface* parse_interface(lexer& lex)
 
     if (lex.current_token != token::open_curly)
     {
-        std::printf("ERROR: Unexpected token '%s' after declaration of interface '%s'; expected an '{'\n", lex.string_value.c_str(), result->name.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' after declaration of interface '%.*s'; expected an '{'\n", SV_ARG(lex.string_value), SV_ARG(result->name));
         return nullptr;
     }
 
     result->definition = parse_object(lex);
     if (!result->definition)
     {
-        std::printf("NOTE: While processing interface '%s'\n", result->name.c_str());
+        lex.report("NOTE: While processing interface '%.*s'\n", SV_ARG(result->name));
         return nullptr;
     }
-    result->definition->parent = result.get();
+    result->definition->parent = result;
 
-    auto resultPtr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return resultPtr;
+    return result;
 }
 
 static ast::node* parse_export(lexer& lex)
 {
     assert(lex.current_token == token::keyword_export);
     lex.advance();
+
+    // Ambient declarations describe the same shapes as regular ones
+    if (lex.current_token == token::keyword_declare) lex.advance();
+
     switch (lex.current_token)
     {
     case token::keyword_module:
@@ -571,7 +622,7 @@ static ast::node* parse_export(lexer& lex)
     }
 
     default:
-        std::printf("ERROR: Unexpected token '%s' while parsing export\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' while parsing export\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 }
@@ -599,11 +650,11 @@ static ast::import_stmt* parse_import(lexer& lex)
 
     if (lex.current_token != token::string)
     {
-        std::printf("ERROR: Unexpected token '%s' while parsing import; expected a string\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' while parsing import; expected a string\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
-    auto result = std::make_unique<ast::import_stmt>();
+    auto result = lex.file->make<ast::import_stmt>();
     result->module_name = lex.string_value;
     lex.advance();
 
@@ -612,9 +663,7 @@ static ast::import_stmt* parse_import(lexer& lex)
         lex.advance();
     }
 
-    auto ptr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return ptr;
+    return result;
 }
 
 static ast::enumeration* parse_enum(lexer& lex)
@@ -624,24 +673,25 @@ static ast::enumeration* parse_enum(lexer& lex)
 
     if (lex.current_token != token::identifier)
     {
-        std::printf("ERROR: Unexpected token '%s' for name of enum; expected an identifier\n", lex.string_value.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' for name of enum; expected an identifier\n", SV_ARG(lex.string_value));
         return nullptr;
     }
 
-    auto result = std::make_unique<ast::enumeration>();
-    result->name.swap(lex.string_value);
+    auto result = lex.file->make<ast::enumeration>();
+    result->name = lex.string_value;
+    result->name_id = lex.file->symbols.intern(result->name);
 
     lex.advance();
     if (lex.current_token != token::open_curly)
     {
-        std::printf("ERROR: Unexpected token '%s' after declaration of enum '%s'; expected an '{'\n", lex.string_value.c_str(), result->name.c_str());
+        lex.report("ERROR: Unexpected token '%.*s' after declaration of enum '%.*s'; expected an '{'\n", SV_ARG(lex.string_value), SV_ARG(result->name));
         return nullptr;
     }
 
     lex.advance();
     while (lex.current_token != token::close_curly && lex.current_token != token::eof)
     {
-        if (lex.current_token == token::identifier)
+        if (is_name_token(lex.current_token))
         {
             ast::enum_member member;
             member.name = lex.string_value;
@@ -657,100 +707,171 @@ static ast::enumeration* parse_enum(lexer& lex)
             }
             result->members.push_back(member);
         }
+        else if (lex.current_token != token::comma)
+        {
+            lex.report("ERROR: Unexpected token '%.*s' while parsing enum '%.*s' body\n", SV_ARG(lex.string_value), SV_ARG(result->name));
+            return nullptr;
+        }
         if (lex.current_token == token::comma)
         {
             lex.advance();
         }
     }
 
-    if (lex.current_token == token::close_curly) lex.advance();
+    if (lex.current_token != token::close_curly)
+    {
+        lex.report("ERROR: Unexpected end of file while parsing enum '%.*s' body; expected '}'\n", SV_ARG(result->name));
+        return nullptr;
+    }
+    lex.advance(); // Consume the '}'
 
-    auto resultPtr = result.get();
-    lex.file->nodes.push_back(std::move(result));
-    return resultPtr;
+    return result;
 }
 
-std::unique_ptr<ast::file> parse_file(std::istream& input)
+/**
+ * @brief Parses top-level statements until the end of the input.
+ *
+ * Calls 'on_statement' with the declaration each statement produced (nullptr for those that declare nothing, such as
+ * 'declare' or 'use strict') and a pointer to its first token. Stray semicolons are skipped without a call, so that
+ * they stay part of the statement before them.
+ *
+ * @return False if a syntax error was encountered.
+ */
+template <typename Func>
+static bool parse_statements(lexer& lex, bool at_file_start, Func&& on_statement)
 {
-    auto result = std::make_unique<ast::file>();
-
-    lexer lex(input, result.get());
-    bool firstToken = true;
+    auto* file = lex.file;
+    bool firstToken = at_file_start;
     while (lex)
     {
+        const char* begin = lex.token_begin;
+        ast::node* ptr = nullptr;
         switch (lex.current_token)
         {
         case token::semicolon:
             lex.advance();
-            break;
+            continue;
 
         case token::string:
             if (lex.string_value != "use strict"sv)
             {
-                std::printf("ERROR: String '%s' unexpected at file scope\n", lex.string_value.c_str());
-                return nullptr;
+                lex.report("ERROR: String '%.*s' unexpected at file scope\n", SV_ARG(lex.string_value));
+                return false;
             }
             else if (lex.advance(); lex.current_token != token::semicolon)
             {
-                std::printf("ERROR: Missing ';' after 'use strict'\n");
-                return nullptr;
+                lex.report("ERROR: Missing ';' after 'use strict'\n");
+                return false;
             }
             else if (!firstToken)
             {
-                std::printf("ERROR: 'use strict' must be the first statement\n");
-                return nullptr;
+                lex.report("ERROR: 'use strict' must be the first statement\n");
+                return false;
             }
-            result->strict = true;
+            file->strict = true;
+            lex.advance();
+            break;
+
+        case token::keyword_declare:
+            // Ambient declarations describe the same shapes as regular ones
             lex.advance();
             break;
 
         case token::keyword_export:
-        {
-            auto ptr = parse_export(lex);
-            if (!ptr) return nullptr;
-            ptr->parent = result.get();
-            result->children.push_back(ptr);
-        }   break;
+            ptr = parse_export(lex);
+            if (!ptr) return false;
+            break;
 
         case token::keyword_type:
-        {
-            auto ptr = parse_type_alias(lex);
-            if (!ptr) return nullptr;
-            ptr->parent = result.get();
-            result->children.push_back(ptr);
-        }   break;
+            ptr = parse_type_alias(lex);
+            if (!ptr) return false;
+            break;
 
         case token::keyword_import:
-        {
-            auto ptr = parse_import(lex);
-            if (!ptr) return nullptr;
-            ptr->parent = result.get();
-            result->children.push_back(ptr);
-        }   break;
+            ptr = parse_import(lex);
+            if (!ptr) return false;
+            break;
 
         case token::keyword_interface:
-        {
-            auto ptr = parse_interface(lex);
-            if (!ptr) return nullptr;
-            ptr->parent = result.get();
-            result->children.push_back(ptr);
-        }   break;
+            ptr = parse_interface(lex);
+            if (!ptr) return false;
+            break;
 
         case token::keyword_enum:
-        {
-            auto ptr = parse_enum(lex);
-            if (!ptr) return nullptr;
-            ptr->parent = result.get();
-            result->children.push_back(ptr);
-        }   break;
+            ptr = parse_enum(lex);
+            if (!ptr) return false;
+            break;
+
+        case token::keyword_module:
+            ptr = parse_module(lex);
+            if (!ptr) return false;
+            break;
 
         default:
-            std::printf("ERROR: Token '%s' unexpected at file scope\n", lex.string_value.c_str());
-            return nullptr;
+            lex.report("ERROR: Token '%.*s' unexpected at file scope\n", SV_ARG(lex.string_value));
+            return false;
         }
 
+        if (ptr) ptr->parent = file;
+        on_statement(ptr, begin);
         firstToken = false;
     }
 
+    return true;
+}
+
+std::unique_ptr<ast::file> parse_file(std::string_view source, std::ostream& diagnostics)
+{
+    auto result = std::make_unique<ast::file>();
+
+    lexer lex(source, result.get(), diagnostics);
+    auto add_child = [&](ast::node* ptr, const char*) {
+        if (ptr) result->children.push_back(ptr);
+    };
+    if (!parse_statements(lex, true, add_child)) return nullptr;
+
     return result;
 }
+
+bool parse_file(std::string_view source, ast::file& file, const std::function<void(ast::node*)>& on_declaration,
+    std::ostream& diagnostics)
+{
+    lexer lex(source, &file, diagnostics);
+    auto add_child = [&](ast::node* ptr, const char*) {
+        if (!ptr) return;
+        file.children.push_back(ptr);
+        on_declaration(ptr);
+    };
+    return parse_statements(lex, true, add_child);
+}
+
+bool parse_statements(std::string_view source, ast::file* file, bool at_file_start,
+    std::vector<parsed_statement>& statements, std::ostream& diagnostics)
+{
+    lexer lex(source, file, diagnostics);
+    auto add_statement = [&](ast::node* ptr, const char* begin) {
+        statements.push_back({ ptr, static_cast<std::size_t>(begin - source.data()) });
+    };
+
+    // Unlike a whole-file parse, a lexing error must fail here too, or the statements after it would be lost
+    return parse_statements(lex, at_file_start, add_statement) && (lex.current_token == token::eof);
+}
+
+std::unique_ptr<ast::file> parse_file(std::unique_ptr<source_buffer> source, std::ostream& diagnostics)
+{
+    auto result = parse_file(source->text(), diagnostics);
+    if (result) result->source = std::move(source);
+    return result;
+}
+
+std::unique_ptr<ast::file> parse_file(std::istream& input, std::ostream& diagnostics)
+{
+    auto source = source_buffer::read_stream(input);
+    if (!source)
+    {
+        diagnostics << "ERROR: Failed to read data from file\n";
+        return nullptr;
+    }
+
+    return parse_file(std::move(source), diagnostics);
+}
@@ -1,6 +1,65 @@
 #pragma once
 
-#include <istream>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <vector>
 #include "ast.h"
+#include "source_buffer.h"
 
-std::unique_ptr<ast::file> parse_file(std::istream& input);
+/**
+ * @brief Parses TypeScript source held in a contiguous buffer.
+ *
+ * @param source The complete source text. Names in the resulting tree are views into this text, so it must outlive
+ * the returned file.
+ * @param diagnostics Where syntax errors are reported.
+ * @return The parsed file, or nullptr if a syntax error was encountered.
+ */
+std::unique_ptr<ast::file> parse_file(std::string_view source, std::ostream& diagnostics);
+
+/**
+ * @brief Parses TypeScript source into an existing, empty file, passing each top-level declaration to 'on_declaration'
+ * as soon as it has been parsed and added to the file's children, e.g. so that output can be generated from the start
+ * of a large file while the rest of it is still being parsed.
+ *
+ * @return False if a syntax error was encountered.
+ */
+bool parse_file(std::string_view source, ast::file& file, const std::function<void(ast::node*)>& on_declaration,
+    std::ostream& diagnostics);
+
+/**
+ * @brief Parses a source buffer, transferring ownership of it to the resulting file.
+ */
+std::unique_ptr<ast::file> parse_file(std::unique_ptr<source_buffer> source, std::ostream& diagnostics);
+
+/**
+ * @brief Convenience overload that reads the whole stream into memory and parses it.
+ */
+std::unique_ptr<ast::file> parse_file(std::istream& input, std::ostream& diagnostics);
+
+/**
+ * @brief A top-level statement and where its first token starts in the text it was parsed from.
+ */
+struct parsed_statement
+{
+    ast::node* node; /*!< The declaration; nullptr for statements that don't declare anything, e.g. 'declare' */
+    std::size_t offset;
+};
+
+/**
+ * @brief Parses a run of complete top-level statements into an existing file, e.g. to replace declarations whose text
+ * has been edited.
+ *
+ * New nodes are allocated from the file's arena and their names interned with its interner, but the file's children
+ * are left for the caller to update.
+ *
+ * @param source The statements' text, which must outlive the file.
+ * @param file The file the statements belong to.
+ * @param at_file_start True if 'source' begins at the start of the file, where 'use strict' may appear.
+ * @param statements Receives each statement, in order.
+ * @param diagnostics Where syntax errors are reported.
+ * @return False if a syntax error was encountered.
+ */
+bool parse_statements(std::string_view source, ast::file* file, bool at_file_start,
+    std::vector<parsed_statement>& statements, std::ostream& diagnostics);
@@ -0,0 +1,62 @@
+#include "pipeline.h"
+
+#include <thread>
+
+#include "parser.h"
+#include "spsc_queue.h"
+#include "emit/codegen_cpp.h"
+#include "emit/codegen_proto.h"
+
+/**
+ * @brief A declaration on its way from the parser to the generator. A null node marks the end of the file.
+ */
+struct parsed_declaration
+{
+    ast::node* node = nullptr;
+    ast::node_id node_count = 0; /*!< The file's node count once the declaration had been parsed */
+};
+
+/**
+ * @brief Parses the file on a new thread, calling 'generate' on this one with each declaration in turn.
+ *
+ * @return False if a syntax error was encountered.
+ */
+template <typename Func>
+static bool run_pipeline(std::string_view source, ast::file& file, std::ostream& diagnostics, Func&& generate)
+{
+    // Deep enough that the parser rarely waits when the generator falls briefly behind
+    auto queue = std::make_unique<spsc_queue<parsed_declaration, 1024>>();
+
+    bool parsed = false;
+    std::thread parser([&] {
+        parsed = parse_file(source, file, [&](ast::node* node) { queue->push({ node, file.node_count() }); },
+            diagnostics);
+        queue->push({});
+    });
+
+    for (auto next = queue->pop(); next.node; next = queue->pop()) generate(next);
+    parser.join();
+    return parsed;
+}
+
+std::unique_ptr<ast::file> parse_and_generate(std::string_view source, const std::string& format,
+    const codegen_config& config, const std::function<void(ast::file&)>& after_parse, std::ostream& out,
+    std::ostream& diagnostics)
+{
+    auto file = std::make_unique<ast::file>();
+    if (format == "proto")
+    {
+        proto_pipeline_generator generator(out, file.get(), config);
+        auto add = [&](const parsed_declaration& next) { generator.add(next.node); };
+        if (!run_pipeline(source, *file, diagnostics, add)) return nullptr;
+        after_parse(*file);
+        return file;
+    }
+
+    cpp_pipeline_generator generator(file.get(), config);
+    auto add = [&](const parsed_declaration& next) { generator.add(next.node, next.node_count); };
+    if (!run_pipeline(source, *file, diagnostics, add)) return nullptr;
+    after_parse(*file);
+    generator.finish(out);
+    return file;
+}
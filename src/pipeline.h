@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "ast.h"
+#include "config.h"
+
+/**
+ * @brief Parses source text on a second thread while this one generates output from each top-level declaration as
+ * soon as it has been parsed, so that converting one large file takes about as long as the slower of the two rather
+ * than both together.
+ *
+ * The output is exactly what parse_file() followed by generate_cpp() or generate_proto() would write.
+ *
+ * @param format "cpp" or "proto".
+ * @param after_parse Called on this thread once the whole file has been parsed and before the output is finished,
+ * e.g. to link imported declarations into it. Not called if parsing fails.
+ * @param diagnostics Where syntax errors are reported, from the parsing thread.
+ * @return The parsed file, or nullptr if a syntax error was encountered, in which case the proto for the declarations
+ * before it may already have been written.
+ */
+std::unique_ptr<ast::file> parse_and_generate(std::string_view source, const std::string& format,
+    const codegen_config& config, const std::function<void(ast::file&)>& after_parse, std::ostream& out,
+    std::ostream& diagnostics);
@@ -0,0 +1,250 @@
+#include "scan.h"
+
+#include <atomic>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCAN_X86_64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define SCAN_X86_64 0
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere; GCC and Clang only in functions built for it
+#if defined(__GNUC__) || defined(__clang__)
+#define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCAN_TARGET_AVX2
+#endif
+
+// Scalar kernels, which the vector kernels also use for the tail of the input too short for a full vector
+
+static const char* scalar_skip_whitespace(const char* pos, const char* end)
+{
+    while ((pos != end) && is_whitespace(*pos)) ++pos;
+    return pos;
+}
+
+static const char* scalar_find_newline(const char* pos, const char* end)
+{
+    while ((pos != end) && (*pos != '\n')) ++pos;
+    return pos;
+}
+
+static const char* scalar_find_comment_end(const char* pos, const char* end)
+{
+    for (; end - pos >= 2; ++pos)
+    {
+        if ((pos[0] == '*') && (pos[1] == '/')) return pos;
+    }
+    return end;
+}
+
+static const char* scalar_skip_identifier(const char* pos, const char* end)
+{
+    while ((pos != end) && is_valid_identifier_character(*pos)) ++pos;
+    return pos;
+}
+
+#if SCAN_X86_64
+
+static unsigned first_set_bit(unsigned mask) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+/**
+ * @brief Steps through [pos, end) a vector at a time until 'stops' reports a match, and finishes with 'tail'.
+ *
+ * @tparam reach How many bytes 'stops' reads from its argument; at least the vector width.
+ * @tparam stops Returns a bit mask with bit i set if the run stops at pos + i.
+ */
+template <std::ptrdiff_t width, std::ptrdiff_t reach, unsigned (*stops)(const char*),
+    const char* (*tail)(const char*, const char*)>
+static const char* scan_sse2(const char* pos, const char* end)
+{
+    for (; end - pos >= reach; pos += width)
+    {
+        if (const unsigned mask = stops(pos)) return pos + first_set_bit(mask);
+    }
+    return tail(pos, end);
+}
+
+// As scan_sse2, built for AVX2 so that AVX2 'stops' can be inlined into it
+template <std::ptrdiff_t width, std::ptrdiff_t reach, unsigned (*stops)(const char*),
+    const char* (*tail)(const char*, const char*)>
+SCAN_TARGET_AVX2 static const char* scan_avx2(const char* pos, const char* end)
+{
+    for (; end - pos >= reach; pos += width)
+    {
+        if (const unsigned mask = stops(pos)) return pos + first_set_bit(mask);
+    }
+    return tail(pos, end);
+}
+
+// SSE2: 16 bytes per step
+
+static __m128i load_128(const char* pos)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+}
+
+static unsigned mask_128(__m128i bytes)
+{
+    return static_cast<unsigned>(_mm_movemask_epi8(bytes));
+}
+
+// Bytes of 'v' in [low, high]; the subtraction wraps smaller values round to large ones, so one unsigned comparison
+// checks both ends
+static __m128i in_range_128(__m128i v, char low, char high)
+{
+    const __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(static_cast<char>(high - low))), offset);
+}
+
+static unsigned non_whitespace_128(const char* pos)
+{
+    const __m128i v = load_128(pos);
+    const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range_128(v, '\t', '\r'));
+    return ~mask_128(space) & 0xffffu;
+}
+
+static unsigned newlines_128(const char* pos)
+{
+    return mask_128(_mm_cmpeq_epi8(load_128(pos), _mm_set1_epi8('\n')));
+}
+
+static unsigned comment_ends_128(const char* pos)
+{
+    const __m128i star = _mm_cmpeq_epi8(load_128(pos), _mm_set1_epi8('*'));
+    const __m128i slash = _mm_cmpeq_epi8(load_128(pos + 1), _mm_set1_epi8('/'));
+    return mask_128(_mm_and_si128(star, slash));
+}
+
+static unsigned non_identifier_128(const char* pos)
+{
+    const __m128i v = load_128(pos);
+    // Setting bit 5 maps 'A'-'Z' onto 'a'-'z', and nothing else onto them
+    const __m128i letter = in_range_128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    const __m128i digit = in_range_128(v, '0', '9');
+    const __m128i other = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+    return ~mask_128(_mm_or_si128(_mm_or_si128(letter, digit), other)) & 0xffffu;
+}
+
+// AVX2: 32 bytes per step, for the comment kernels only; see all_kernels
+
+SCAN_TARGET_AVX2 static __m256i load_256(const char* pos)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+}
+
+SCAN_TARGET_AVX2 static unsigned mask_256(__m256i bytes)
+{
+    return static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+}
+
+SCAN_TARGET_AVX2 static unsigned newlines_256(const char* pos)
+{
+    return mask_256(_mm256_cmpeq_epi8(load_256(pos), _mm256_set1_epi8('\n')));
+}
+
+SCAN_TARGET_AVX2 static unsigned comment_ends_256(const char* pos)
+{
+    const __m256i star = _mm256_cmpeq_epi8(load_256(pos), _mm256_set1_epi8('*'));
+    const __m256i slash = _mm256_cmpeq_epi8(load_256(pos + 1), _mm256_set1_epi8('/'));
+    return mask_256(_mm256_and_si256(star, slash));
+}
+
+#endif
+
+static const scan_kernels all_kernels[] = {
+    { scan_level::scalar, scalar_skip_whitespace, scalar_find_newline, scalar_find_comment_end,
+        scalar_skip_identifier },
+#if SCAN_X86_64
+    { scan_level::sse2,
+        scan_sse2<16, 16, non_whitespace_128, scalar_skip_whitespace>,
+        scan_sse2<16, 16, newlines_128, scalar_find_newline>,
+        scan_sse2<16, 17, comment_ends_128, scalar_find_comment_end>,
+        scan_sse2<16, 16, non_identifier_128, scalar_skip_identifier> },
+    // Whitespace runs and identifiers are nearly always shorter than 16 bytes, so wider vectors only add loads that
+    // split cache lines; measured in the lexer, they were slower than SSE2 for those. Comments run long enough to gain.
+    { scan_level::avx2,
+        scan_sse2<16, 16, non_whitespace_128, scalar_skip_whitespace>,
+        scan_avx2<32, 32, newlines_256, scalar_find_newline>,
+        scan_avx2<32, 33, comment_ends_256, scalar_find_comment_end>,
+        scan_sse2<16, 16, non_identifier_128, scalar_skip_identifier> },
+#endif
+};
+
+static scan_level detect_scan_level() noexcept
+{
+#if SCAN_X86_64
+#if defined(_MSC_VER) && !defined(__clang__)
+    // AVX2 needs the CPU to have it and the OS to save the YMM registers on a context switch
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        const bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        __cpuidex(info, 7, 0);
+        if (os_saves_ymm && (info[1] & (1 << 5))) return scan_level::avx2;
+    }
+#else
+    // Also checks that the OS saves the YMM registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scan_level::avx2;
+#endif
+    return scan_level::sse2;
+#else
+    return scan_level::scalar;
+#endif
+}
+
+scan_level best_scan_level() noexcept
+{
+    static const scan_level level = detect_scan_level();
+    return level;
+}
+
+const scan_kernels& scan_kernels_for(scan_level level) noexcept
+{
+    if (level > best_scan_level()) level = best_scan_level();
+    return all_kernels[static_cast<std::size_t>(level)];
+}
+
+static std::atomic<const scan_kernels*>& active_kernels() noexcept
+{
+    static std::atomic<const scan_kernels*> kernels{ &scan_kernels_for(best_scan_level()) };
+    return kernels;
+}
+
+const scan_kernels& active_scan_kernels() noexcept
+{
+    return *active_kernels().load(std::memory_order_relaxed);
+}
+
+void use_scan_level(scan_level level) noexcept
+{
+    active_kernels().store(&scan_kernels_for(level), std::memory_order_relaxed);
+}
+
+const char* scan_level_name(scan_level level) noexcept
+{
+    switch (level)
+    {
+    case scan_level::scalar: return "scalar";
+    case scan_level::sse2: return "sse2";
+    case scan_level::avx2: return "avx2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// The characters the lexer classifies, shared with the kernels below so that every level agrees on them
+constexpr bool in_range(char ch, char begin, char end) noexcept
+{
+    return (ch >= begin) && (ch <= end);
+}
+
+constexpr bool is_whitespace(char ch) noexcept
+{
+    return (ch == ' ') || (ch == '\f') || (ch == '\n') || (ch == '\r') ||
+        (ch == '\t') || (ch == '\v');
+}
+
+constexpr bool is_valid_identifier_start(char ch) noexcept
+{
+    return in_range(ch, 'A', 'Z') || in_range(ch, 'a', 'z') || ch == '_' || ch == '$';
+}
+
+constexpr bool is_valid_identifier_character(char ch) noexcept
+{
+    return is_valid_identifier_start(ch) || in_range(ch, '0', '9');
+}
+
+/**
+ * @brief The instruction sets the lexer's scanning kernels are built for, from slowest to fastest.
+ */
+enum class scan_level
+{
+    scalar, /*!< One byte at a time; available everywhere */
+    sse2,   /*!< 16 bytes at a time; every x86-64 CPU */
+    avx2    /*!< Comments 32 bytes at a time, the rest as SSE2; chosen only if the CPU and OS support it */
+};
+
+/**
+ * @brief Finds where the runs of characters the lexer skips over or collects end.
+ *
+ * Each kernel takes the unread part of the source, [pos, end), and returns a pointer into it, or 'end' if the run
+ * reaches it. No kernel reads outside [pos, end), so the buffer needs no padding.
+ */
+struct scan_kernels
+{
+    scan_level level;
+
+    // The first character that isn't whitespace
+    const char* (*skip_whitespace)(const char* pos, const char* end);
+
+    // The first '\n', which ends a line comment
+    const char* (*find_newline)(const char* pos, const char* end);
+
+    // The '*' of the first "*/", which ends a block comment
+    const char* (*find_comment_end)(const char* pos, const char* end);
+
+    // The first character that can't continue an identifier
+    const char* (*skip_identifier)(const char* pos, const char* end);
+};
+
+/**
+ * @brief Returns the fastest level this CPU supports, as detected when the program started.
+ */
+scan_level best_scan_level() noexcept;
+
+/**
+ * @brief Returns the kernels for 'level', which must be no faster than best_scan_level().
+ */
+const scan_kernels& scan_kernels_for(scan_level level) noexcept;
+
+/**
+ * @brief Returns the kernels the lexer uses; those for best_scan_level() unless changed with use_scan_level.
+ */
+const scan_kernels& active_scan_kernels() noexcept;
+
+/**
+ * @brief Makes lexers created from now on use the kernels for 'level', e.g. to compare levels in benchmarks. Levels
+ * the CPU doesn't support fall back to the best one it does.
+ */
+void use_scan_level(scan_level level) noexcept;
+
+/**
+ * @brief Returns the level's name, e.g. "avx2".
+ */
+const char* scan_level_name(scan_level level) noexcept;
@@ -0,0 +1,317 @@
+#include "server.h"
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+#include "config.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Fields larger than this are taken to mean the stream is out of step rather than allocated
+static constexpr std::uint32_t max_field_size = 1u << 30;
+
+// Once this many distinct configs have been seen, the parsed settings are dropped and built up again
+static constexpr std::size_t max_cached_configs = 64;
+
+static bool read_field(std::istream& in, std::string& field)
+{
+    unsigned char size_bytes[4];
+    if (!in.read(reinterpret_cast<char*>(size_bytes), sizeof(size_bytes))) return false;
+
+    std::uint32_t size = 0;
+    for (int i = 3; i >= 0; --i) size = (size << 8) | size_bytes[i];
+    if (size > max_field_size) return false;
+
+    field.resize(size);
+    return size == 0 || in.read(field.data(), size);
+}
+
+static void write_field(std::ostream& out, const std::string& field)
+{
+    const auto size = static_cast<std::uint32_t>(field.size());
+    const char size_bytes[4] = {
+        static_cast<char>(size & 0xff),
+        static_cast<char>((size >> 8) & 0xff),
+        static_cast<char>((size >> 16) & 0xff),
+        static_cast<char>((size >> 24) & 0xff),
+    };
+    out.write(size_bytes, sizeof(size_bytes));
+    out.write(field.data(), static_cast<std::streamsize>(field.size()));
+}
+
+bool read_request(std::istream& in, server_request& request)
+{
+    return read_field(in, request.config) && read_field(in, request.name) && read_field(in, request.source);
+}
+
+bool write_request(std::ostream& out, const server_request& request)
+{
+    write_field(out, request.config);
+    write_field(out, request.name);
+    write_field(out, request.source);
+    return static_cast<bool>(out.flush());
+}
+
+bool read_response(std::istream& in, server_response& response)
+{
+    char status;
+    if (!in.get(status)) return false;
+    response.ok = (status == 0);
+    return read_field(in, response.output) && read_field(in, response.diagnostics);
+}
+
+bool write_response(std::ostream& out, const server_response& response)
+{
+    out.put(response.ok ? 0 : 1);
+    write_field(out, response.output);
+    write_field(out, response.diagnostics);
+    return static_cast<bool>(out.flush());
+}
+
+std::shared_ptr<const conversion_settings> generator_server::settings_for(const std::string& config,
+    std::ostream& diagnostics)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = configs.find(config);
+        if (it != configs.end()) return it->second;
+    }
+
+    // Parsed outside the lock; two threads seeing the same new config at once just both parse it
+    auto settings = std::make_shared<conversion_settings>();
+    if (!parse_config_text(config, settings->config, settings->format, diagnostics)) return nullptr;
+    settings->modules = &modules;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (configs.size() >= max_cached_configs) configs.clear();
+    return configs.emplace(config, std::move(settings)).first->second;
+}
+
+server_response generator_server::handle(const server_request& request)
+{
+    server_response response;
+    std::ostringstream output;
+    std::ostringstream diagnostics;
+
+    if (auto settings = settings_for(request.config, diagnostics))
+    {
+        response.ok = convert_text(request.name, request.source, *settings, output, diagnostics);
+    }
+
+    if (response.ok) response.output = output.str();
+    response.diagnostics = diagnostics.str();
+    return response;
+}
+
+/**
+ * @brief Answers requests until the input ends between two requests.
+ */
+static bool serve_stream(generator_server& server, std::istream& in, std::ostream& out)
+{
+    server_request request;
+    while (in.peek() != std::char_traits<char>::eof())
+    {
+        if (!read_request(in, request)) return false;
+        if (!write_response(out, server.handle(request))) return false;
+    }
+    return true;
+}
+
+bool serve_stdio(generator_server& server)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+    return serve_stream(server, std::cin, std::cout);
+}
+
+#ifndef _WIN32
+
+#ifdef MSG_NOSIGNAL
+static constexpr int send_flags = MSG_NOSIGNAL; // A client hanging up must not kill the server with SIGPIPE
+#else
+static constexpr int send_flags = 0;
+#endif
+
+/**
+ * @brief A buffered stream over a connected socket.
+ */
+class socket_streambuf : public std::streambuf
+{
+public:
+    explicit socket_streambuf(int fd) : fd(fd)
+    {
+        setg(input, input, input);
+        setp(output, output + sizeof(output));
+    }
+
+protected:
+    int_type underflow() override
+    {
+        ssize_t received;
+        do {
+            received = recv(fd, input, sizeof(input), 0);
+        } while (received < 0 && errno == EINTR);
+        if (received <= 0) return traits_type::eof();
+
+        setg(input, input, input + received);
+        return traits_type::to_int_type(input[0]);
+    }
+
+    int_type overflow(int_type ch) override
+    {
+        if (!send_buffered()) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override { return send_buffered() ? 0 : -1; }
+
+private:
+    bool send_buffered()
+    {
+        const char* next = pbase();
+        while (next < pptr())
+        {
+            const ssize_t sent = send(fd, next, static_cast<std::size_t>(pptr() - next), send_flags);
+            if (sent < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            next += sent;
+        }
+        setp(output, output + sizeof(output));
+        return true;
+    }
+
+    int fd;
+    char input[64 * 1024];
+    char output[64 * 1024];
+};
+
+static bool make_address(const std::string& path, sockaddr_un& address, std::ostream& diagnostics)
+{
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        diagnostics << "ERROR: Socket path '" << path << "' is too long\n";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool serve_socket(generator_server& server, const std::string& path, std::ostream& diagnostics)
+{
+    sockaddr_un address;
+    if (!make_address(path, address, diagnostics)) return false;
+
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(path.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        diagnostics << "ERROR: Failed to listen on socket '" << path << "': " << std::strerror(errno) << "\n";
+        if (listener >= 0) close(listener);
+        return false;
+    }
+
+    for (;;)
+    {
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            diagnostics << "ERROR: Failed to accept connection: " << std::strerror(errno) << "\n";
+            close(listener);
+            return false;
+        }
+
+        std::thread([&server, connection] {
+            auto buffer = std::make_unique<socket_streambuf>(connection);
+            std::iostream stream(buffer.get());
+            serve_stream(server, stream, stream);
+            close(connection);
+        }).detach();
+    }
+}
+
+server_connection::~server_connection()
+{
+    stream.reset();
+    buffer.reset();
+    if (fd >= 0) close(fd);
+}
+
+bool server_connection::connect(const std::string& path, std::ostream& diagnostics)
+{
+    sockaddr_un address;
+    if (!make_address(path, address, diagnostics)) return false;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        diagnostics << "ERROR: Failed to connect to server at '" << path << "': " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    buffer = std::make_unique<socket_streambuf>(fd);
+    stream = std::make_unique<std::iostream>(buffer.get());
+    return true;
+}
+
+bool server_connection::send(const server_request& request, server_response& response, std::ostream& diagnostics)
+{
+    if (stream && write_request(*stream, request) && read_response(*stream, response)) return true;
+
+    diagnostics << "ERROR: Server closed the connection without answering\n";
+    return false;
+}
+
+#else
+
+bool serve_socket(generator_server&, const std::string& path, std::ostream& diagnostics)
+{
+    diagnostics << "ERROR: Serving on a socket ('" << path << "') isn't supported on this platform; use --serve\n";
+    return false;
+}
+
+server_connection::~server_connection() = default;
+
+bool server_connection::connect(const std::string& path, std::ostream& diagnostics)
+{
+    diagnostics << "ERROR: Connecting to a server socket ('" << path << "') isn't supported on this platform\n";
+    return false;
+}
+
+bool server_connection::send(const server_request&, server_response&, std::ostream& diagnostics)
+{
+    diagnostics << "ERROR: Not connected to a server\n";
+    return false;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+
+#include "driver.h"
+#include "module_graph.h"
+
+/**
+ * @brief One conversion asked of the server: the source text plus everything needed to convert it.
+ *
+ * On the wire, a request is its three fields in this order, and a response is a status byte (0 for success) followed
+ * by its two fields. Each field is a 32-bit little-endian byte count followed by that many bytes.
+ */
+struct server_request {
+    std::string config; /*!< TOML configuration text; empty for the default settings */
+    std::string name;   /*!< What to call the input in the generated output and in errors */
+    std::string source; /*!< The TypeScript to convert */
+};
+
+/**
+ * @brief The result of one request.
+ */
+struct server_response {
+    bool ok = false;
+    std::string output;      /*!< The generated C++ or proto; empty on failure */
+    std::string diagnostics; /*!< Errors and warnings, in the same form the command line prints them */
+};
+
+/**
+ * @brief Reads and writes protocol messages. Reads return false on a malformed or truncated message.
+ */
+bool read_request(std::istream& in, server_request& request);
+bool write_request(std::ostream& out, const server_request& request);
+bool read_response(std::istream& in, server_response& response);
+bool write_response(std::ostream& out, const server_response& response);
+
+/**
+ * @brief Converts requests, keeping the settings parsed from each distinct config between them, and the files they
+ * import.
+ *
+ * A request's relative imports are resolved from the directory of its name. Imported files are parsed once and shared
+ * by every request, and parsed again only once they change. Safe to use from several threads at once.
+ */
+class generator_server
+{
+public:
+    /**
+     * @param thread_count The number of imported files parsed at once; zero uses one per hardware thread.
+     */
+    explicit generator_server(std::size_t thread_count = 1) : modules(thread_count, nullptr, true) {}
+
+    server_response handle(const server_request& request);
+
+private:
+    std::shared_ptr<const conversion_settings> settings_for(const std::string& config, std::ostream& diagnostics);
+
+    module_graph modules;
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const conversion_settings>> configs;
+};
+
+/**
+ * @brief Answers requests read from stdin on stdout until stdin is closed.
+ *
+ * @return False if a malformed request was received or the response couldn't be written.
+ */
+bool serve_stdio(generator_server& server);
+
+/**
+ * @brief Listens on a Unix domain socket and answers requests on every connection until the process is stopped.
+ *
+ * Each connection may send any number of requests, one after another, and is served on its own thread.
+ *
+ * @param path Where to create the socket. A stale socket left there by an earlier server is replaced.
+ * @return False if the socket couldn't be created.
+ */
+bool serve_socket(generator_server& server, const std::string& path, std::ostream& diagnostics);
+
+/**
+ * @brief A connection to a server listening on a Unix domain socket, over which any number of requests can be sent.
+ */
+class server_connection
+{
+public:
+    server_connection() = default;
+    ~server_connection();
+
+    server_connection(const server_connection&) = delete;
+    server_connection& operator=(const server_connection&) = delete;
+
+    bool connect(const std::string& path, std::ostream& diagnostics);
+
+    /**
+     * @brief Sends a request and waits for its response.
+     *
+     * @return False if the server closed the connection without answering.
+     */
+    bool send(const server_request& request, server_response& response, std::ostream& diagnostics);
+
+private:
+    int fd = -1;
+    std::unique_ptr<std::streambuf> buffer;
+    std::unique_ptr<std::iostream> stream;
+};
@@ -0,0 +1,113 @@
+#include "source_buffer.h"
+
+#include <istream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+source_buffer::~source_buffer()
+{
+    if (!mapping) return;
+
+#ifdef _WIN32
+    ::UnmapViewOfFile(mapping);
+#else
+    ::munmap(mapping, size);
+#endif
+}
+
+std::unique_ptr<source_buffer> source_buffer::map_file(const std::string& path)
+{
+    auto result = std::make_unique<source_buffer>();
+
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size))
+    {
+        ::CloseHandle(file);
+        return nullptr;
+    }
+
+    // Mapping a zero-length file is an error on Windows; an empty buffer is all we need
+    if (file_size.QuadPart > 0)
+    {
+        HANDLE map = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (map)
+        {
+            result->mapping = ::MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+            ::CloseHandle(map);
+        }
+
+        if (!result->mapping)
+        {
+            ::CloseHandle(file);
+            return nullptr;
+        }
+        result->data = static_cast<const char*>(result->mapping);
+        result->size = static_cast<std::size_t>(file_size.QuadPart);
+    }
+    ::CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // mmap rejects zero-length mappings; an empty buffer is all we need
+    if (st.st_size > 0)
+    {
+        void* ptr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+        ::madvise(ptr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        result->mapping = ptr;
+        result->data = static_cast<const char*>(ptr);
+        result->size = static_cast<std::size_t>(st.st_size);
+    }
+    ::close(fd);
+#endif
+
+    return result;
+}
+
+std::unique_ptr<source_buffer> source_buffer::read_stream(std::istream& input)
+{
+    auto result = std::make_unique<source_buffer>();
+
+    // In blocks rather than through a character iterator, which is several times slower for large files
+    char block[64 * 1024];
+    while (input.read(block, sizeof(block)) || input.gcount() > 0)
+    {
+        result->storage.append(block, static_cast<std::size_t>(input.gcount()));
+    }
+    if (input.bad()) return nullptr;
+
+    result->data = result->storage.data();
+    result->size = result->storage.size();
+    return result;
+}
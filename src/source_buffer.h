@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief A contiguous, read-only block of source text that the lexer can scan with raw pointers.
+ *
+ * Files are memory-mapped where the platform allows it, so no copy of the input is ever made. Streams (e.g. stdin)
+ * cannot be mapped and are instead read into memory once, up front.
+ */
+struct source_buffer
+{
+    source_buffer() = default;
+    source_buffer(const source_buffer&) = delete;
+    source_buffer& operator=(const source_buffer&) = delete;
+    ~source_buffer();
+
+    /**
+     * @brief Maps the file at the given path into memory.
+     *
+     * @param path The path of the file to map.
+     * @return The mapped buffer, or nullptr if the file could not be opened or mapped.
+     */
+    static std::unique_ptr<source_buffer> map_file(const std::string& path);
+
+    /**
+     * @brief Reads the remaining contents of a stream into memory.
+     *
+     * @param input The stream to read; read until end-of-file.
+     * @return The buffered contents, or nullptr if reading from the stream failed.
+     */
+    static std::unique_ptr<source_buffer> read_stream(std::istream& input);
+
+    std::string_view text() const noexcept { return { data, size }; }
+
+private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    // Exactly one of these owns 'data' (or neither, for an empty buffer)
+    std::string storage;
+    void* mapping = nullptr;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief A fixed-capacity queue from exactly one producer thread to exactly one consumer thread, without locks.
+ *
+ * Each side only ever stores to its own index, so a push or pop is a copy and a release store. A side that finds the
+ * queue full, or empty, yields its thread until the other side catches up.
+ */
+template <typename T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+    /**
+     * @brief Adds a value at the back, waiting for room if the queue is full. Only called by the producer.
+     */
+    void push(T value)
+    {
+        const auto tail = next_push.load(std::memory_order_relaxed);
+        while (tail - next_pop.load(std::memory_order_acquire) == Capacity) std::this_thread::yield();
+
+        slots[tail & (Capacity - 1)] = std::move(value);
+        next_push.store(tail + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Removes the value at the front, waiting for one if the queue is empty. Only called by the consumer.
+     */
+    T pop()
+    {
+        const auto head = next_pop.load(std::memory_order_relaxed);
+        while (next_push.load(std::memory_order_acquire) == head) std::this_thread::yield();
+
+        T value = std::move(slots[head & (Capacity - 1)]);
+        next_pop.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+
+    // Both only ever increase; kept on separate cache lines so that the two threads don't contend for one
+    alignas(64) std::atomic<std::size_t> next_push{ 0 };
+    alignas(64) std::atomic<std::size_t> next_pop{ 0 };
+};
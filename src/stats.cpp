@@ -0,0 +1,292 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Counted per thread, so that threads converting files in parallel don't contend on a shared counter
+thread_local std::size_t allocation_count = 0;
+
+std::size_t thread_allocation_count() noexcept
+{
+    return allocation_count;
+}
+
+std::size_t peak_resident_bytes() noexcept
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static const char* const node_kind_names[node_kind_count] = {
+    "file",
+    "import_stmt",
+    "module",
+    "member",
+    "object",
+    "interface",
+    "interface_reference",
+    "fundamental_type_reference",
+    "array",
+    "enumeration",
+    "type_alias",
+    "union_type",
+    "intersection_type",
+    "literal_type",
+    "tuple_type",
+    "template_literal_type",
+    "generic_type_reference",
+    "mapped_type",
+    "conditional_type",
+};
+
+void count_nodes(const ast::node* n, std::array<std::size_t, node_kind_count>& counts)
+{
+    if (!n) return;
+    ++counts[static_cast<std::size_t>(n->kind)];
+    switch (n->kind)
+    {
+    case ast::node_kind::file:
+        for (auto* child : static_cast<const ast::file*>(n)->children) count_nodes(child, counts);
+        break;
+    case ast::node_kind::module:
+        for (auto* child : static_cast<const ast::module*>(n)->children) count_nodes(child, counts);
+        break;
+    case ast::node_kind::member:
+        count_nodes(static_cast<const ast::member*>(n)->type, counts);
+        break;
+    case ast::node_kind::object:
+        for (auto* m : static_cast<const ast::object*>(n)->named_members) count_nodes(m, counts);
+        break;
+    case ast::node_kind::interface: {
+        auto* iface = static_cast<const ast::interface*>(n);
+        for (auto* b : iface->base) count_nodes(b, counts);
+        count_nodes(iface->definition, counts);
+        break;
+    }
+    case ast::node_kind::array:
+        count_nodes(static_cast<const ast::array*>(n)->type, counts);
+        break;
+    case ast::node_kind::type_alias:
+        count_nodes(static_cast<const ast::type_alias*>(n)->target_type, counts);
+        break;
+    case ast::node_kind::union_type:
+        for (auto* t : static_cast<const ast::union_type*>(n)->types) count_nodes(t, counts);
+        break;
+    case ast::node_kind::intersection_type:
+        for (auto* t : static_cast<const ast::intersection_type*>(n)->types) count_nodes(t, counts);
+        break;
+    case ast::node_kind::tuple_type:
+        for (auto* t : static_cast<const ast::tuple_type*>(n)->elements) count_nodes(t, counts);
+        break;
+    case ast::node_kind::generic_type_reference:
+        for (auto* arg : static_cast<const ast::generic_type_reference*>(n)->arguments) count_nodes(arg, counts);
+        break;
+    case ast::node_kind::mapped_type: {
+        auto* mapped = static_cast<const ast::mapped_type*>(n);
+        count_nodes(mapped->key_type, counts);
+        count_nodes(mapped->value_type, counts);
+        break;
+    }
+    case ast::node_kind::conditional_type: {
+        auto* cond = static_cast<const ast::conditional_type*>(n);
+        count_nodes(cond->condition, counts);
+        count_nodes(cond->extends_type, counts);
+        count_nodes(cond->true_type, counts);
+        count_nodes(cond->false_type, counts);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void run_stats::add(file_stats stats)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    files.push_back(std::move(stats));
+}
+
+/**
+ * @brief The files in input order, however the threads converting them finished.
+ */
+std::vector<file_stats> run_stats::sorted_files() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto result = files;
+    std::stable_sort(result.begin(), result.end(), [](const file_stats& a, const file_stats& b) {
+        return a.input < b.input;
+    });
+    return result;
+}
+
+static std::size_t total_nodes(const file_stats& stats)
+{
+    std::size_t total = 0;
+    for (auto count : stats.nodes) total += count;
+    return total;
+}
+
+/**
+ * @brief Adds every count and time in 'stats' to 'total'.
+ */
+static void accumulate(file_stats& total, const file_stats& stats)
+{
+    total.lex_ms += stats.lex_ms;
+    total.parse_ms += stats.parse_ms;
+    total.imports_ms += stats.imports_ms;
+    total.generate_ms += stats.generate_ms;
+    total.write_ms += stats.write_ms;
+    total.bytes_in += stats.bytes_in;
+    total.bytes_out += stats.bytes_out;
+    total.tokens += stats.tokens;
+    total.allocations += stats.allocations;
+    for (std::size_t i = 0; i < node_kind_count; ++i) total.nodes[i] += stats.nodes[i];
+}
+
+static void write_counts_text(std::ostream& out, const file_stats& stats)
+{
+    out << stats.bytes_in << " bytes in, " << stats.bytes_out << " bytes out, " << stats.tokens << " tokens, "
+        << total_nodes(stats) << " nodes, " << stats.allocations << " allocations\n";
+}
+
+static void write_phases_text(std::ostream& out, const file_stats& stats)
+{
+    out << "    lex " << stats.lex_ms << " ms, parse " << stats.parse_ms << " ms, imports " << stats.imports_ms
+        << " ms, generate " << stats.generate_ms << " ms, write " << stats.write_ms << " ms\n";
+}
+
+void run_stats::write_text(std::ostream& out) const
+{
+    const auto sorted = sorted_files();
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    file_stats total;
+    for (const auto& stats : sorted)
+    {
+        out << "file " << stats.input << (stats.cached ? " (cached)" : stats.ok ? "" : " (failed)") << ": ";
+        write_counts_text(out, stats);
+        write_phases_text(out, stats);
+        accumulate(total, stats);
+    }
+    out << "total for " << sorted.size() << " file(s): ";
+    write_counts_text(out, total);
+    write_phases_text(out, total);
+
+    out << "config: " << config_ms << " ms\n";
+    if (cache_enabled) {
+        out << "cache: " << cache_hits << " hits, " << cache_misses << " misses\n";
+    } else {
+        out << "cache: disabled\n";
+    }
+    out << "imports: " << imports_parsed << " files parsed";
+    if (cache_enabled) out << ", " << imports_cached << " loaded from the AST cache";
+    out << "\n";
+    out << "peak RSS: " << std::setprecision(1) << peak_resident_bytes() / (1024.0 * 1024.0) << " MiB\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+static void write_json_string(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static void write_json_counts(std::ostream& out, const file_stats& stats, const char* indent)
+{
+    out << indent << "\"bytes_in\": " << stats.bytes_in << ",\n"
+        << indent << "\"bytes_out\": " << stats.bytes_out << ",\n"
+        << indent << "\"tokens\": " << stats.tokens << ",\n"
+        << indent << "\"allocations\": " << stats.allocations << ",\n"
+        << indent << "\"phases_ms\": { \"lex\": " << stats.lex_ms << ", \"parse\": " << stats.parse_ms
+        << ", \"imports\": " << stats.imports_ms << ", \"generate\": " << stats.generate_ms << ", \"write\": "
+        << stats.write_ms << " },\n"
+        << indent << "\"nodes\": {";
+    for (std::size_t i = 0; i < node_kind_count; ++i)
+    {
+        out << (i ? ", " : " ") << '"' << node_kind_names[i] << "\": " << stats.nodes[i];
+    }
+    out << " }";
+}
+
+void run_stats::write_json(std::ostream& out) const
+{
+    const auto sorted = sorted_files();
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\n"
+        << "  \"version\": \"" << TS_TYPE_CONV_VERSION << "\",\n"
+        << "  \"config_ms\": " << config_ms << ",\n";
+    if (cache_enabled) {
+        out << "  \"cache\": { \"hits\": " << cache_hits << ", \"misses\": " << cache_misses << " },\n";
+    } else {
+        out << "  \"cache\": null,\n";
+    }
+    out << "  \"imports_parsed\": " << imports_parsed << ",\n"
+        << "  \"imports_cached\": " << imports_cached << ",\n"
+        << "  \"peak_rss_bytes\": " << peak_resident_bytes() << ",\n"
+        << "  \"files\": [";
+
+    file_stats total;
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        const auto& stats = sorted[i];
+        out << (i ? ",\n" : "\n") << "    {\n"
+            << "      \"input\": ";
+        write_json_string(out, stats.input);
+        out << ",\n      \"output\": ";
+        write_json_string(out, stats.output);
+        out << ",\n      \"ok\": " << (stats.ok ? "true" : "false") << ",\n"
+            << "      \"cached\": " << (stats.cached ? "true" : "false") << ",\n";
+        write_json_counts(out, stats, "      ");
+        out << "\n    }";
+        accumulate(total, stats);
+    }
+    out << (sorted.empty() ? "],\n" : "\n  ],\n")
+        << "  \"total\": {\n"
+        << "    \"files\": " << sorted.size() << ",\n";
+    write_json_counts(out, total, "    ");
+    out << "\n  }\n}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+/**
+ * @brief The number of node kinds, for arrays indexed by ast::node_kind.
+ */
+inline constexpr std::size_t node_kind_count = static_cast<std::size_t>(ast::node_kind::conditional_type) + 1;
+
+/**
+ * @brief Measurements taken while converting one file with --stats.
+ */
+struct file_stats
+{
+    std::string input;
+    std::string output;
+    bool ok = false;
+    bool cached = false; /*!< Written out from the output cache, so nothing was lexed, parsed or generated */
+
+    // Wall time of each phase in milliseconds. Lexing is timed by a separate pass over the text, as the parser lexes
+    // on demand; 'parse' includes the lexing it does itself.
+    double lex_ms = 0;
+    double parse_ms = 0;
+    double imports_ms = 0; /*!< Loading imported files and copying in the declarations used from them */
+    double generate_ms = 0;
+    double write_ms = 0;
+
+    std::size_t bytes_in = 0;
+    std::size_t bytes_out = 0;
+    std::size_t tokens = 0;
+    std::array<std::size_t, node_kind_count> nodes{}; /*!< Nodes in the file's tree by kind, excluding imported copies */
+    std::size_t allocations = 0; /*!< Heap allocations made by the converting thread */
+};
+
+/**
+ * @brief Collects file_stats from every file converted in a run and reports them.
+ *
+ * Safe to add to from several threads at once.
+ */
+class run_stats
+{
+public:
+    void add(file_stats stats);
+
+    double config_ms = 0;
+    std::size_t cache_hits = 0;
+    std::size_t cache_misses = 0;
+    bool cache_enabled = false;
+    std::size_t imports_parsed = 0;
+    std::size_t imports_cached = 0; /*!< Imported files loaded from the AST cache rather than parsed */
+
+    /**
+     * @brief Writes one line per file and the totals for the run, for people.
+     */
+    void write_text(std::ostream& out) const;
+
+    /**
+     * @brief Writes the same as write_text, and the node counts by kind, as a JSON document.
+     */
+    void write_json(std::ostream& out) const;
+
+private:
+    std::vector<file_stats> sorted_files() const;
+
+    mutable std::mutex mutex;
+    std::vector<file_stats> files;
+};
+
+/**
+ * @brief Counts the nodes reachable from 'n' by kind, adding to 'counts'.
+ */
+void count_nodes(const ast::node* n, std::array<std::size_t, node_kind_count>& counts);
+
+/**
+ * @brief Heap allocations made by the calling thread so far. Only the executable counts them, by replacing operator
+ * new in count_allocations.cpp; a program using the library keeps its own allocator, and this stays at zero.
+ */
+extern thread_local std::size_t allocation_count;
+
+/**
+ * @brief The number of heap allocations made by the calling thread so far, or zero if they aren't being counted.
+ */
+std::size_t thread_allocation_count() noexcept;
+
+/**
+ * @brief The most memory the process has had resident at once, in bytes, or zero if it can't be determined.
+ */
+std::size_t peak_resident_bytes() noexcept;
+
+/**
+ * @brief Milliseconds elapsed since 'start'.
+ */
+inline double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,59 @@
+#include "symbols.h"
+
+#include <iterator>
+
+using namespace std::literals;
+
+namespace ast
+{
+    // Must match the order of the builtin enumeration
+    static constexpr std::string_view builtin_names[] = {
+        "any"sv,
+        "boolean"sv,
+        "number"sv,
+        "string"sv,
+        "unknown"sv,
+        "never"sv,
+        "undefined"sv,
+        "Array"sv,
+        "ReadonlyArray"sv,
+        "Record"sv,
+        "NonNullable"sv,
+        "Partial"sv,
+        "Readonly"sv,
+        "Omit"sv,
+        "Pick"sv,
+        "Capitalize"sv,
+        "Uncapitalize"sv,
+        "Uppercase"sv,
+        "Lowercase"sv,
+        "Exclude"sv,
+        "Extract"sv,
+        "typeof"sv,
+    };
+    static_assert(std::size(builtin_names) == builtin::count, "builtin_names is out of sync with ast::builtin");
+
+    symbol_interner::symbol_interner()
+    {
+        for (auto name : builtin_names) intern(name);
+    }
+
+    symbol_id symbol_interner::intern(std::string_view name)
+    {
+        auto [it, inserted] = ids.try_emplace(name, static_cast<symbol_id>(names.size()));
+        if (inserted) names.push_back(name);
+        return it->second;
+    }
+
+    void symbol_interner::reserve(std::size_t count)
+    {
+        ids.reserve(count);
+        names.reserve(count);
+    }
+
+    symbol_id symbol_interner::find(std::string_view name) const
+    {
+        auto it = ids.find(name);
+        return (it != ids.end()) ? it->second : invalid_symbol;
+    }
+}
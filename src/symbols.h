@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ast
+{
+    /**
+     * @brief Dense integer identifier for a name, unique within a file. Usable directly as an index into flat arrays.
+     */
+    using symbol_id = std::uint32_t;
+
+    constexpr symbol_id invalid_symbol = ~symbol_id(0);
+
+    /**
+     * @brief Names with a fixed meaning to the emitters. Every interner assigns them these ids, so they can be compared
+     * against without any string comparisons.
+     */
+    namespace builtin
+    {
+        enum : symbol_id
+        {
+            // Fundamental types, as named in configuration files
+            any,
+            boolean,
+            number,
+            string,
+            unknown,
+            never,
+
+            undefined,
+            Array,
+            ReadonlyArray,
+            Record,
+            NonNullable,
+            Partial,
+            Readonly,
+            Omit,
+            Pick,
+            Capitalize,
+            Uncapitalize,
+            Uppercase,
+            Lowercase,
+            Exclude,
+            Extract,
+            type_query, // typeof
+
+            count
+        };
+    }
+
+    /**
+     * @brief Maps each distinct name to a symbol_id and back.
+     *
+     * Names are stored as views, so the text they refer to (normally the file's source buffer) must outlive the
+     * interner.
+     */
+    struct symbol_interner
+    {
+        symbol_interner();
+
+        symbol_id intern(std::string_view name);
+
+        /**
+         * @brief Makes room for 'count' names in all, so that interning that many doesn't rehash along the way.
+         */
+        void reserve(std::size_t count);
+
+        /**
+         * @brief Returns the id of a name that has already been interned, or invalid_symbol.
+         */
+        symbol_id find(std::string_view name) const;
+
+        std::string_view name(symbol_id id) const { return names[id]; }
+        std::size_t size() const noexcept { return names.size(); }
+
+    private:
+        std::unordered_map<std::string_view, symbol_id> ids;
+        std::vector<std::string_view> names;
+    };
+}
@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+
+// The pool and queue index of the worker running on this thread, if any
+static thread_local const work_stealing_pool* current_pool = nullptr;
+static thread_local std::size_t current_index = 0;
+
+work_stealing_pool::work_stealing_pool(std::size_t thread_count)
+{
+    if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) thread_count = 1;
+
+    queues.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) queues.push_back(std::make_unique<worker_queue>());
+
+    threads.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) threads.emplace_back([this, i] { run_worker(i); });
+}
+
+work_stealing_pool::~work_stealing_pool()
+{
+    wait();
+    {
+        std::lock_guard lock(state_mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void work_stealing_pool::submit(std::function<void()> task)
+{
+    std::size_t index;
+    {
+        std::lock_guard lock(state_mutex);
+        ++pending;
+        if (current_pool == this) {
+            index = current_index;
+        } else {
+            index = next_queue;
+            next_queue = (next_queue + 1) % queues.size();
+        }
+    }
+
+    {
+        auto& queue = *queues[index];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard lock(state_mutex);
+        ++queued;
+    }
+    work_available.notify_one();
+}
+
+void work_stealing_pool::wait()
+{
+    std::unique_lock lock(state_mutex);
+    all_done.wait(lock, [this] { return pending == 0; });
+}
+
+bool work_stealing_pool::try_take(std::size_t self, std::function<void()>& task)
+{
+    {
+        auto& own = *queues[self];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < queues.size(); ++i)
+    {
+        auto& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_pool::run_worker(std::size_t index)
+{
+    current_pool = this;
+    current_index = index;
+
+    std::function<void()> task;
+    while (true)
+    {
+        if (try_take(index, task))
+        {
+            {
+                std::lock_guard lock(state_mutex);
+                --queued;
+            }
+            task();
+            task = nullptr;
+
+            std::lock_guard lock(state_mutex);
+            if (--pending == 0) all_done.notify_all();
+            continue;
+        }
+
+        std::unique_lock lock(state_mutex);
+        work_available.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued <= 0) return;
+    }
+}
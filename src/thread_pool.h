@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads, each with its own task queue, that take work from each other when idle.
+ *
+ * A worker runs the newest task on its own queue first, and an idle worker takes the oldest task from another's. Tasks
+ * submitted from inside a task go to the submitting worker's queue, so work that fans out stays local until someone
+ * else runs dry.
+ */
+class work_stealing_pool
+{
+public:
+    /**
+     * @param thread_count The number of workers; zero uses one per hardware thread.
+     */
+    explicit work_stealing_pool(std::size_t thread_count);
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    /**
+     * @brief Waits for every queued task, then stops the workers.
+     */
+    ~work_stealing_pool();
+
+    /**
+     * @brief Queues a task to run on some worker. Tasks must not throw.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Blocks until every submitted task, including those submitted by other tasks, has finished.
+     *
+     * Must not be called from inside a task.
+     */
+    void wait();
+
+    std::size_t size() const noexcept { return threads.size(); }
+
+private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool try_take(std::size_t self, std::function<void()>& task);
+    void run_worker(std::size_t index);
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+
+    // Tasks submitted but not yet finished
+    std::size_t pending = 0;
+
+    // Tasks pushed but not yet taken. Signed, as a task may be taken before its push is counted.
+    std::ptrdiff_t queued = 0;
+
+    // Queue for the next task submitted from outside the pool
+    std::size_t next_queue = 0;
+
+    bool stopping = false;
+};
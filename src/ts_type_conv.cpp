@@ -0,0 +1,113 @@
+#include "ts_type_conv.h"
+
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <utility>
+
+#include "driver.h"
+
+/**
+ * @brief Appends everything written to it to a string, so that output is built where the caller wants it rather than
+ * in a stream's own buffer and then copied out.
+ */
+class string_appender : public std::streambuf
+{
+public:
+    explicit string_appender(std::string& target) : target(target) {}
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize count) override
+    {
+        target.append(data, static_cast<std::size_t>(count));
+        return count;
+    }
+
+    int_type overflow(int_type ch) override
+    {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) target.push_back(traits_type::to_char_type(ch));
+        return traits_type::not_eof(ch);
+    }
+
+private:
+    std::string& target;
+};
+
+/**
+ * @brief Splits diagnostics text, as the command line prints it, into one diagnostic per line.
+ */
+static void split_diagnostics(const std::string& text, std::vector<diagnostic>& diagnostics)
+{
+    static constexpr std::pair<std::string_view, diagnostic_severity> prefixes[] = {
+        { "ERROR: ", diagnostic_severity::error },
+        { "WARNING: ", diagnostic_severity::warning },
+        { "NOTE: ", diagnostic_severity::note },
+    };
+
+    std::string_view rest = text;
+    while (!rest.empty())
+    {
+        const auto end = rest.find('\n');
+        std::string_view line = rest.substr(0, end);
+        rest.remove_prefix((end == std::string_view::npos) ? rest.size() : end + 1);
+        if (line.empty()) continue;
+
+        // Unprefixed lines are the driver's own summaries of a failure
+        diagnostic entry;
+        for (const auto& [prefix, severity] : prefixes)
+        {
+            if (line.substr(0, prefix.size()) == prefix)
+            {
+                entry.severity = severity;
+                line.remove_prefix(prefix.size());
+                break;
+            }
+        }
+        entry.message = line;
+        diagnostics.push_back(std::move(entry));
+    }
+}
+
+converter::converter(codegen_config config, std::string format)
+{
+    auto built = std::make_shared<conversion_settings>();
+    built->config = std::move(config);
+    built->format = std::move(format);
+    settings = std::move(built);
+}
+
+conversion_result converter::convert(std::string_view source, const std::string& name) const
+{
+    conversion_result result;
+    convert(source, name, result);
+    return result;
+}
+
+bool converter::convert(std::string_view source, const std::string& name, conversion_result& result) const
+{
+    result.output.clear();
+    result.diagnostics.clear();
+
+    if (settings->format != "cpp" && settings->format != "proto")
+    {
+        result.ok = false;
+        result.diagnostics.push_back({ diagnostic_severity::error,
+            "format '" + settings->format + "' is not supported. Only 'cpp' and 'proto' formats are supported." });
+        return false;
+    }
+
+    string_appender output_buffer(result.output);
+    std::ostream out(&output_buffer);
+    std::ostringstream diagnostics;
+    result.ok = convert_text(name, source, *settings, out, diagnostics);
+    if (!result.ok) result.output.clear();
+
+    split_diagnostics(diagnostics.str(), result.diagnostics);
+    return result.ok;
+}
+
+conversion_result convert_source(std::string_view source, const codegen_config& config, const std::string& format,
+    const std::string& name)
+{
+    return converter(config, format).convert(source, name);
+}
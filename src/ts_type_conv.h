@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.h"
+
+struct conversion_settings;
+
+/**
+ * @brief How serious a diagnostic is.
+ */
+enum class diagnostic_severity {
+    error,   /*!< The conversion failed, or produced something other than what the input describes */
+    warning, /*!< The output was generated but may not be what was intended */
+    note     /*!< More detail about the diagnostic before it */
+};
+
+/**
+ * @brief One message reported while converting.
+ */
+struct diagnostic {
+    diagnostic_severity severity = diagnostic_severity::error;
+    std::string message; /*!< The text of the message, without its "ERROR: " style prefix or trailing newline */
+};
+
+/**
+ * @brief What converting one source produced.
+ */
+struct conversion_result {
+    bool ok = false;
+    std::string output; /*!< The generated C++ or proto; empty on failure */
+    std::vector<diagnostic> diagnostics;
+};
+
+/**
+ * @brief Converts TypeScript held in memory, for programs that embed the converter rather than running it.
+ *
+ * Nothing is read from or written to the file system or the console, and no state is kept outside the object, so
+ * one converter can be used from any number of threads at once. The config is kept from construction, so converting
+ * many sources with the same settings doesn't copy it for each one.
+ */
+class converter
+{
+public:
+    /**
+     * @param config The code generation settings, e.g. as read by parse_config_text.
+     * @param format "cpp" or "proto".
+     */
+    explicit converter(codegen_config config, std::string format = "cpp");
+
+    /**
+     * @brief Converts 'source'.
+     *
+     * @param name What to call the input in errors and in the generated header's preamble.
+     */
+    conversion_result convert(std::string_view source, const std::string& name = "<memory>") const;
+
+    /**
+     * @brief Converts 'source' into 'result', reusing the memory it already holds; useful when converting many sources
+     * one after another.
+     *
+     * @return result.ok
+     */
+    bool convert(std::string_view source, const std::string& name, conversion_result& result) const;
+
+private:
+    // Shared between copies, and never changed once built
+    std::shared_ptr<const conversion_settings> settings;
+};
+
+/**
+ * @brief Converts one source held in memory; see converter.
+ */
+conversion_result convert_source(std::string_view source, const codegen_config& config,
+    const std::string& format = "cpp", const std::string& name = "<memory>");
@@ -0,0 +1,14 @@
+import { Left } from "./import_graph/left";
+import { Right } from "./import_graph/right";
+
+// Left's members come from Base, which only left.ts imports
+export type LeftPatch = Partial<Left>;
+
+export type Tagged = Left & {
+	tag: string;
+};
+
+export interface Pair {
+	left: Left;
+	right: Right;
+}
@@ -0,0 +1,6 @@
+export interface Base {
+	id: number;
+	name: string;
+}
+
+export type Status = "active" | "archived";
@@ -0,0 +1,5 @@
+import { Base, Status } from "./base";
+
+export interface Left extends Base {
+	status: Status;
+}
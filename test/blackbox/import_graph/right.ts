@@ -0,0 +1,3 @@
+import { Base } from "./base";
+
+export type Right = Partial<Base>;
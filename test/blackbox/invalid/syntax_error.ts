@@ -0,0 +1,8 @@
+export interface Valid {
+	id: number;
+	name: string;
+}
+
+export interface Broken {
+	id number;
+}
@@ -0,0 +1,34 @@
+// Utility types and intersections over interfaces with base interfaces
+interface Base {
+	id: number;
+};
+interface Named extends Base {
+	name: string;
+};
+interface Tagged extends Named {
+	tags: string[];
+};
+export type PartialTagged = Partial<Tagged>;
+export type TaggedWithoutName = Omit<Tagged, "name">;
+export type TaggedIdentity = Pick<Tagged, "id" | "name">;
+export type TaggedExtra = Tagged & { extra: boolean };
+
+// Self-referential declarations cannot be flattened. Do not emit, and do not recurse forever.
+interface Left extends Right {
+	left: number;
+};
+interface Right extends Left {
+	right: number;
+};
+export type PartialLeft = Partial<Left>;
+export type Recursive = Recursive & { value: number };
+export type Ping = { ping: number } & Pong;
+export type Pong = Ping & { pong: number };
+
+// Aliases naming themselves are not literal unions either
+export type SelfUnion = SelfUnion | "x";
+export type Echo = Reply;
+export type Reply = Echo;
+export type Mark = Tick | "mark";
+export type Tick = Mark | "tick";
+export type Shouted = Uppercase<Shouted>;
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ts_type_conv.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+int main()
+{
+    const std::string source = "export interface Point {\n\tx: number;\n\ty?: string;\n}\n"
+                               "export type Shape = \"circle\" | \"square\";\n";
+
+    // C++ and proto output, with the config passed in rather than read from a file
+    const auto cpp = convert_source(source, codegen_config());
+    check(cpp.ok && cpp.diagnostics.empty(), "C++ conversion succeeds without diagnostics");
+    check(contains(cpp.output, "struct Point") && contains(cpp.output, "enum class Shape"), "C++ declarations");
+    check(contains(cpp.output, "from <memory>") && !contains(cpp.output, "stdin"), "the preamble names no file");
+
+    const auto proto = convert_source(source, codegen_config(), "proto");
+    check(proto.ok && contains(proto.output, "message Point"), "proto declarations");
+
+    // A parse error fails with structured diagnostics and no output
+    const auto broken = convert_source("export interface Broken {\n\tx number;\n}\n", codegen_config(), "cpp", "broken.ts");
+    check(!broken.ok && broken.output.empty(), "a parse error fails without output");
+    check(!broken.diagnostics.empty() && broken.diagnostics.front().severity == diagnostic_severity::error &&
+        contains(broken.diagnostics.front().message, "Unexpected token"), "a parse error is reported as an error");
+    check(contains(broken.diagnostics.back().message, "broken.ts"), "errors name the input");
+
+    // Messages aren't cut short, however long the names they quote
+    const std::string long_name(2000, 'n');
+    const auto long_error = convert_source("export type " + long_name + " number;\n", codegen_config());
+    check(!long_error.ok && !long_error.diagnostics.empty() &&
+        contains(long_error.diagnostics.front().message, "type alias '" + long_name + "'; expected '='"),
+        "a long name is quoted in full");
+
+    const auto unsupported = convert_source(source, codegen_config(), "json");
+    check(!unsupported.ok && unsupported.diagnostics.size() == 1, "an unsupported format is reported");
+
+    // One converter, reused results, and several threads at once all give the same output
+    const converter shared(codegen_config{});
+    conversion_result reused;
+    shared.convert(broken.output, "<memory>", reused);
+    check(shared.convert(source, "<memory>", reused) && reused.output == cpp.output && reused.diagnostics.empty(),
+        "a reused result holds only the latest conversion");
+
+    std::vector<conversion_result> results(8);
+    std::vector<std::thread> threads;
+    for (auto& result : results)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 50; ++i) shared.convert(source, "<memory>", result);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (const auto& result : results) check(result.ok && result.output == cpp.output, "concurrent conversions");
+
+    if (failures == 0) std::cout << "All library tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
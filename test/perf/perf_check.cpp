@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One line of the baseline file: the expected value of a metric for a fixture, and how far it may regress.
+ */
+struct baseline_entry
+{
+    std::string fixture;
+    std::string metric;
+    double value = 0;
+    double tolerance = 0; // Percent
+};
+
+/**
+ * @brief What one run of the converter measured.
+ */
+struct measurement
+{
+    double throughput_mb_s = 0;
+    double peak_rss_mb = 0;
+    double allocations = 0;
+};
+
+// Higher is better for throughput; lower is better for everything else
+static bool higher_is_better(const std::string& metric)
+{
+    return metric == "throughput_mb_s";
+}
+
+static bool read_baseline(const std::string& path, std::vector<baseline_entry>& entries, std::vector<std::string>& lines)
+{
+    std::ifstream in(path);
+    if (in.fail()) return false;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        lines.push_back(line);
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        baseline_entry entry;
+        std::istringstream fields(line);
+        if (!(fields >> entry.fixture >> entry.metric >> entry.value >> entry.tolerance))
+        {
+            std::cerr << "ERROR: Malformed baseline line '" << line << "'\n";
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the number following "key": after 'from' in a --stats-json document.
+ */
+static bool json_number(const std::string& json, const std::string& key, std::size_t from, double& value)
+{
+    const auto pos = json.find("\"" + key + "\":", from);
+    if (pos == std::string::npos) return false;
+    value = std::strtod(json.c_str() + pos + key.size() + 3, nullptr);
+    return true;
+}
+
+static bool read_stats(const std::string& path, measurement& result)
+{
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    const std::string json = contents.str();
+
+    // Totals come after the per-file entries; lexing is a separate pass made only for the stats, so it's left out
+    const auto total = json.find("\"total\":");
+    double bytes_in, parse_ms, imports_ms, generate_ms, write_ms, peak_rss;
+    if (total == std::string::npos || !json_number(json, "bytes_in", total, bytes_in) ||
+        !json_number(json, "parse", total, parse_ms) || !json_number(json, "imports", total, imports_ms) ||
+        !json_number(json, "generate", total, generate_ms) || !json_number(json, "write", total, write_ms) ||
+        !json_number(json, "allocations", total, result.allocations) ||
+        !json_number(json, "peak_rss_bytes", 0, peak_rss))
+    {
+        std::cerr << "ERROR: Failed to read measurements from '" << path << "'\n";
+        return false;
+    }
+
+    const double seconds = (parse_ms + imports_ms + generate_ms + write_ms) / 1000.0;
+    result.throughput_mb_s = (seconds > 0) ? bytes_in / (1024.0 * 1024.0) / seconds : 0;
+    result.peak_rss_mb = peak_rss / (1024.0 * 1024.0);
+    return true;
+}
+
+static double metric_value(const measurement& m, const std::string& metric)
+{
+    if (metric == "throughput_mb_s") return m.throughput_mb_s;
+    if (metric == "peak_rss_mb") return m.peak_rss_mb;
+    return m.allocations;
+}
+
+static void print_usage(const char* exe_name)
+{
+    std::cerr << "Usage: " << exe_name << " --baseline FILE --fixture NAME --stats FILE [--runs N] [--tolerance PCT]\n"
+              << "           [--update] -- <command...>\n"
+              << "   Runs the command, which must write --stats-json to the --stats file, and compares its throughput,\n"
+              << "   peak memory and allocation count with the fixture's baseline. With --update, the baseline file is\n"
+              << "   rewritten with the measured values instead.\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string baseline_file, fixture, stats_file;
+    int runs = 3;
+    double tolerance_override = -1;
+    bool update = false;
+    std::string command;
+
+    int i = 1;
+    for (; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (arg == "--baseline" && has_value) {
+            baseline_file = argv[++i];
+        } else if (arg == "--fixture" && has_value) {
+            fixture = argv[++i];
+        } else if (arg == "--stats" && has_value) {
+            stats_file = argv[++i];
+        } else if (arg == "--runs" && has_value) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance_override = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--update") {
+            update = true;
+        } else if (arg == "--") {
+            ++i;
+            break;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    for (; i < argc; ++i) command += std::string(command.empty() ? "\"" : " \"") + argv[i] + "\"";
+    if (baseline_file.empty() || fixture.empty() || stats_file.empty() || command.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<baseline_entry> entries;
+    std::vector<std::string> lines;
+    if (!read_baseline(baseline_file, entries, lines))
+    {
+        std::cerr << "ERROR: Failed to read baseline file '" << baseline_file << "'\n";
+        return 1;
+    }
+
+    // The best of several runs, so that one slow run on a busy machine doesn't fail the check
+    measurement best;
+    for (int run = 0; run < runs; ++run)
+    {
+        measurement m;
+        if (std::system(command.c_str()) != 0)
+        {
+            std::cerr << "ERROR: The converter failed\n";
+            return 1;
+        }
+        if (!read_stats(stats_file, m)) return 1;
+        if (run == 0) {
+            best = m;
+        } else {
+            best.throughput_mb_s = std::max(best.throughput_mb_s, m.throughput_mb_s);
+            best.peak_rss_mb = std::min(best.peak_rss_mb, m.peak_rss_mb);
+            best.allocations = std::min(best.allocations, m.allocations);
+        }
+    }
+
+    if (update)
+    {
+        // Rewrite the fixture's lines in place, keeping their tolerances, comments and everything else
+        static const char* const metrics[] = { "throughput_mb_s", "peak_rss_mb", "allocations" };
+        std::ofstream out(baseline_file);
+        auto write_line = [&](const std::string& metric, double tolerance) {
+            out << std::left << std::setw(16) << fixture << ' ' << std::setw(16) << metric << ' ' << std::setw(12)
+                << std::fixed << std::setprecision(metric == "allocations" ? 0 : 1) << metric_value(best, metric)
+                << ' ' << std::setprecision(0) << tolerance << "\n";
+        };
+        std::vector<std::string> written;
+        for (const auto& line : lines)
+        {
+            std::istringstream fields(line);
+            std::string name, metric;
+            double value, tolerance;
+            if (fields >> name >> metric >> value >> tolerance && name == fixture) {
+                write_line(metric, tolerance);
+                written.push_back(metric);
+            } else {
+                out << line << "\n";
+            }
+        }
+        for (const char* metric : metrics)
+        {
+            if (std::find(written.begin(), written.end(), metric) == written.end()) write_line(metric, 20);
+        }
+        std::cout << "Updated baseline for " << fixture << "\n";
+        return out ? 0 : 1;
+    }
+
+    bool found = false;
+    bool regressed = false;
+    for (const auto& entry : entries)
+    {
+        if (entry.fixture != fixture) continue;
+        found = true;
+
+        const double tolerance = (tolerance_override >= 0) ? tolerance_override : entry.tolerance;
+        const double value = metric_value(best, entry.metric);
+        const double change = (entry.value != 0) ? (value - entry.value) / entry.value * 100.0 : 0;
+        const bool worse = higher_is_better(entry.metric) ? (change < -tolerance) : (change > tolerance);
+
+        std::cout << std::left << std::setw(16) << entry.metric << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << value << "  baseline " << std::setw(14) << entry.value << "  "
+                  << std::showpos << change << std::noshowpos << "% (tolerance " << tolerance << "%)"
+                  << (worse ? "  REGRESSED" : "") << "\n";
+        regressed = regressed || worse;
+    }
+    if (!found)
+    {
+        std::cerr << "ERROR: No baseline for fixture '" << fixture << "' in '" << baseline_file << "'\n";
+        return 1;
+    }
+    return regressed ? 1 : 0;
+}
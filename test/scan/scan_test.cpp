@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scan.h"
+
+static int failures = 0;
+
+/**
+ * @brief Compares every kernel of 'kernels' with the scalar one, from each start offset to each end of 'text'.
+ */
+static void compare(const scan_kernels& kernels, const std::string& text, const char* what)
+{
+    using kernel_function = const char* (*)(const char*, const char*);
+    static const std::pair<const char*, kernel_function scan_kernels::*> functions[] = {
+        { "skip_whitespace", &scan_kernels::skip_whitespace },
+        { "find_newline", &scan_kernels::find_newline },
+        { "find_comment_end", &scan_kernels::find_comment_end },
+        { "skip_identifier", &scan_kernels::skip_identifier },
+    };
+    const scan_kernels& scalar = scan_kernels_for(scan_level::scalar);
+
+    // A copy of exactly the text's size, so that reading past the end is caught by sanitizers
+    const std::vector<char> buffer(text.begin(), text.end());
+    const char* const begin = buffer.data();
+    for (const auto& [name, function] : functions)
+    {
+        for (std::size_t length = 0; length <= buffer.size(); ++length)
+        {
+            for (std::size_t start = 0; start <= length; ++start)
+            {
+                const char* expected = (scalar.*function)(begin + start, begin + length);
+                const char* actual = (kernels.*function)(begin + start, begin + length);
+                if (actual != expected)
+                {
+                    std::cerr << "FAILED: " << scan_level_name(kernels.level) << " " << name << " on " << what
+                              << " [" << start << ", " << length << "): stopped at " << (actual - begin)
+                              << " instead of " << (expected - begin) << "\n";
+                    ++failures;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    // Runs longer than two AVX2 vectors, with stops at the start, middle and end of a vector and none at all
+    std::vector<std::pair<std::string, std::string>> inputs = {
+        { "whitespace", " \t\n\r\v\f" + std::string(70, ' ') + "x\t\t\n  \n" + std::string(33, '\t') },
+        { "identifiers",
+            "abcXYZ_$09" + std::string(40, 'q') + " " + std::string(31, 'Z') + "-" + std::string(64, '_') },
+        { "comments", "/** a * b / c */" + std::string(40, '*') + "/" + std::string(31, ' ') + "*/ // line\n" +
+            std::string(64, '*') },
+        { "line", std::string(15, 'a') + "\n" + std::string(32, 'b') + "\n" + std::string(50, 'c') },
+        // Bytes either side of every range the kernels test, including ones that are negative as char
+        { "boundaries", "\x08\x0e\x1f!#%/:@[`{\x7f\x80\xff\xdf\xc0 " + std::string("\x80\x8a\xaa\xe0\x89\xa0", 6) },
+    };
+
+    // Random text drawn mostly from the characters the kernels stop at or run over
+    static const char alphabet[] = " \t\n*/_$aZ09;\x80";
+    std::uint64_t state = 1;
+    std::string random;
+    for (int i = 0; i < 200; ++i)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        random += alphabet[(state >> 33) % (sizeof(alphabet) - 1)];
+    }
+    inputs.emplace_back("random", random);
+
+    for (int level = 0; level <= static_cast<int>(best_scan_level()); ++level)
+    {
+        const scan_kernels& kernels = scan_kernels_for(static_cast<scan_level>(level));
+        for (const auto& [what, text] : inputs) compare(kernels, text, what.c_str());
+    }
+
+    // Asking for more than the CPU supports gives the best it does
+    if (scan_kernels_for(scan_level::avx2).level != best_scan_level() ||
+        active_scan_kernels().level != best_scan_level())
+    {
+        std::cerr << "FAILED: the lexer doesn't use the best level the CPU supports\n";
+        ++failures;
+    }
+
+    std::cout << "best level: " << scan_level_name(best_scan_level()) << "\n";
+    return failures ? 1 : 0;
+}
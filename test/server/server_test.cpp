@@ -0,0 +1,346 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_io.h"
+#include "server.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+static std::string quote(const std::string& text)
+{
+    return "\"" + text + "\"";
+}
+
+static std::string read_text(const std::string& path)
+{
+    std::string contents;
+    read_file(path, contents, std::ios::binary);
+    return contents;
+}
+
+/**
+ * @brief A fixture converted by the server, with what the command line makes of it.
+ */
+struct fixture
+{
+    std::string input;
+    std::string config_file; // Empty for the default settings
+    std::string config;
+    std::string expected;    // The command line's output; empty if it fails to convert
+};
+
+/**
+ * @brief Converts each fixture with the command line, which is what the server's answers must match.
+ */
+static std::vector<fixture> load_fixtures(const std::string& exe, const std::string& source_dir,
+    const std::string& work_dir)
+{
+    const std::pair<const char*, const char*> files[] = {
+        { "ts_5_9.ts", "ts_5_9.toml" },
+        { "proto_out.ts", "proto_out.toml" },
+        { "import_graph.ts", "" },
+        { "member_flattening.ts", "" },
+        { "invalid/syntax_error.ts", "" },
+    };
+
+    std::vector<fixture> fixtures;
+    for (const auto& [input, config] : files)
+    {
+        fixture f;
+        f.input = source_dir + "/" + input;
+        if (*config) f.config_file = source_dir + "/" + config;
+        f.config = f.config_file.empty() ? "" : read_text(f.config_file);
+
+        const std::string output = work_dir + "/expected_" + std::to_string(fixtures.size());
+        const std::string command = quote(exe) + " " + quote(f.input) + " " + quote(output) +
+            (f.config_file.empty() ? "" : " " + quote(f.config_file)) + " 2>" + quote(output + ".log");
+        if (std::system(command.c_str()) == 0) f.expected = read_text(output);
+        fixtures.push_back(std::move(f));
+    }
+    return fixtures;
+}
+
+static void check_response(const fixture& f, const server_response& response, const std::string& what)
+{
+    if (f.expected.empty())
+    {
+        check(!response.ok && response.output.empty(), what + ": a parse error fails without output");
+        check(contains(response.diagnostics, "Unexpected token") && contains(response.diagnostics, f.input),
+            what + ": a parse error is reported, naming the input");
+    }
+    else
+    {
+        check(response.ok && response.output == f.expected, what + ": output matches the command line for " + f.input);
+    }
+}
+
+/**
+ * @brief Runs --serve on a file of framed requests and returns its exit code, with the framed responses.
+ */
+static int serve_file(const std::string& exe, const std::string& work_dir, const std::string& requests,
+    std::string& responses)
+{
+    const std::string request_file = work_dir + "/requests.bin";
+    const std::string response_file = work_dir + "/responses.bin";
+    replace_file(request_file, requests, std::ios::binary);
+    const std::string command = quote(exe) + " --serve <" + quote(request_file) + " >" + quote(response_file);
+    const int status = std::system(command.c_str());
+    responses = read_text(response_file);
+    return status;
+}
+
+/**
+ * @brief Sends every fixture to --serve over stdio, each several times with configs that differ only in a comment,
+ * enough of them to overflow the server's cache of parsed configs.
+ */
+static void test_stdio(const std::string& exe, const std::string& work_dir, const std::vector<fixture>& fixtures)
+{
+    std::ostringstream requests;
+    std::vector<const fixture*> sent;
+    for (int round = 0; round < 20; ++round)
+    {
+        for (const auto& f : fixtures)
+        {
+            server_request request;
+            request.config = f.config + "\n# " + std::to_string(round) + "\n";
+            request.name = f.input;
+            request.source = read_text(f.input);
+            write_request(requests, request);
+            sent.push_back(&f);
+        }
+    }
+
+    std::string responses;
+    check(serve_file(exe, work_dir, requests.str(), responses) == 0, "--serve exits cleanly at the end of its input");
+
+    std::istringstream in(responses);
+    for (std::size_t i = 0; i < sent.size(); ++i)
+    {
+        server_response response;
+        if (!read_response(in, response))
+        {
+            check(false, "--serve answers request " + std::to_string(i));
+            return;
+        }
+        check_response(*sent[i], response, "--serve request " + std::to_string(i));
+    }
+    check(in.peek() == std::char_traits<char>::eof(), "--serve sends one response per request");
+
+    // A frame cut short is answered with nothing and ends the server with an error, after answering those before it
+    const std::string whole = requests.str();
+    check(serve_file(exe, work_dir, whole.substr(0, whole.size() - 3), responses) != 0,
+        "--serve fails on a truncated request");
+    std::istringstream truncated(responses);
+    std::size_t answered = 0;
+    for (server_response response; read_response(truncated, response);) ++answered;
+    check(answered == sent.size() - 1, "--serve answers every whole request before a truncated one");
+
+    // So does a field too large to be anything but garbage
+    check(serve_file(exe, work_dir, std::string(4, '\xff'), responses) != 0 && responses.empty(),
+        "--serve fails on a malformed frame");
+}
+
+#ifndef _WIN32
+
+/**
+ * @brief Connects to the socket, retrying while the server starts.
+ */
+static int connect_raw(const std::string& path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) return fd;
+        if (fd >= 0) close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+/**
+ * @brief Converts a file importing another, edits the imported file, and converts the importing file again, checking
+ * that the server's output matches the command line's each time rather than reusing the imported file as first parsed.
+ */
+static void test_changed_import(const std::string& exe, const std::string& socket_path, const std::string& work_dir)
+{
+    const std::string importer = work_dir + "/importer.ts";
+    const std::string imported = work_dir + "/imported.ts";
+    replace_file(importer, "import { Base } from \"./imported\";\nexport type Loose = Partial<Base>;\n");
+
+    server_connection connection;
+    std::ostringstream diagnostics;
+    check(connection.connect(socket_path, diagnostics), "a connection for the changed import is accepted");
+
+    const char* versions[] = {
+        "export interface Base {\n\tx: number;\n}\n",
+        "export interface Base {\n\tx: number;\n\ty: string;\n}\n",
+    };
+    for (const char* version : versions)
+    {
+        replace_file(imported, version);
+        const std::string expected = work_dir + "/importer_expected.h";
+        const std::string command = quote(exe) + " " + quote(importer) + " " + quote(expected);
+        check(std::system(command.c_str()) == 0, "the command line converts the importing file");
+
+        server_request request{ "", importer, read_text(importer) };
+        server_response response;
+        check(connection.send(request, response, diagnostics) && response.ok &&
+            response.output == read_text(expected), "the server's output follows the imported file as it changes");
+    }
+}
+
+/**
+ * @brief Starts --serve-socket, then converts the fixtures with --client and from several connections at once.
+ */
+static void test_socket(const std::string& exe, const std::string& work_dir, const std::vector<fixture>& fixtures)
+{
+    const std::string socket_path = work_dir + "/server.sock";
+    const pid_t server = fork();
+    if (server == 0)
+    {
+        execl(exe.c_str(), exe.c_str(), "--serve-socket", socket_path.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    const int probe = connect_raw(socket_path);
+    check(probe >= 0, "--serve-socket accepts connections");
+    if (probe >= 0)
+    {
+        // A malformed frame closes that connection without an answer, and the server carries on
+        const char garbage[4] = { '\xff', '\xff', '\xff', '\xff' };
+        check(send(probe, garbage, sizeof(garbage), 0) == sizeof(garbage), "a malformed frame is sent");
+        char reply;
+        check(recv(probe, &reply, 1, 0) == 0, "a malformed frame closes the connection without an answer");
+        close(probe);
+
+        // --client for a single file, with the config it needs
+        for (const auto& f : fixtures)
+        {
+            if (f.config_file.empty()) continue;
+            const std::string output = work_dir + "/client_" + std::to_string(&f - fixtures.data());
+            const std::string command = quote(exe) + " --client " + quote(socket_path) + " " + quote(f.input) + " " +
+                quote(output) + " " + quote(f.config_file);
+            check(std::system(command.c_str()) == 0 && read_text(output) == f.expected,
+                "--client output matches the command line for " + f.input);
+        }
+
+        // --client --batch over one connection, for the files that use the default settings, one of which fails
+        std::ostringstream manifest;
+        for (const auto& f : fixtures)
+        {
+            if (!f.config_file.empty()) continue;
+            manifest << f.input << " " << work_dir << "/batch_" << (&f - fixtures.data()) << "\n";
+        }
+        replace_file(work_dir + "/client.manifest", manifest.str());
+        const std::string log = work_dir + "/client.log";
+        const std::string command = quote(exe) + " --client " + quote(socket_path) + " --batch " +
+            quote(work_dir + "/client.manifest") + " 2>" + quote(log);
+        check(std::system(command.c_str()) != 0, "--client --batch fails if any file fails");
+
+        const std::string report = read_text(log);
+        check(contains(report, "OK: " + fixtures[2].input) && contains(report, "FAILED: " + fixtures.back().input) &&
+            contains(report, "2 of 3 files converted"), "--client --batch reports each file as a local batch does");
+        check(contains(report, "Unexpected token"), "--client --batch passes on the server's diagnostics");
+        check(read_text(work_dir + "/batch_2") == fixtures[2].expected,
+            "--client --batch writes the output, with the imported declarations");
+
+        test_changed_import(exe, socket_path, work_dir);
+
+        // Several connections at once, each served on its own thread
+        std::vector<std::thread> clients;
+        for (int t = 0; t < 4; ++t)
+        {
+            clients.emplace_back([&, t] {
+                server_connection connection;
+                std::ostringstream diagnostics;
+                if (!connection.connect(socket_path, diagnostics))
+                {
+                    check(false, "connection " + std::to_string(t) + " is accepted");
+                    return;
+                }
+                for (int i = 0; i < 10; ++i)
+                {
+                    const auto& f = fixtures[static_cast<std::size_t>(t + i) % fixtures.size()];
+                    server_request request{ f.config, f.input, read_text(f.input) };
+                    server_response response;
+                    if (!connection.send(request, response, diagnostics))
+                    {
+                        check(false, "connection " + std::to_string(t) + " is answered");
+                        return;
+                    }
+                    check_response(f, response, "connection " + std::to_string(t));
+                }
+            });
+        }
+        for (auto& client : clients) client.join();
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+    if (argc != 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ts-type-conv> <fixture_dir> <work_dir> stdio|socket\n";
+        return 1;
+    }
+    const std::string exe = argv[1];
+    const std::string mode = argv[4];
+
+    const auto fixtures = load_fixtures(exe, argv[2], argv[3]);
+    check(fixtures.back().expected.empty(), "the syntax error fixture fails on the command line");
+    for (std::size_t i = 0; i + 1 < fixtures.size(); ++i)
+    {
+        check(!fixtures[i].expected.empty(), "the command line converts " + fixtures[i].input);
+    }
+
+    if (mode == "stdio") {
+        test_stdio(exe, argv[3], fixtures);
+    }
+#ifndef _WIN32
+    else if (mode == "socket") {
+        test_socket(exe, argv[3], fixtures);
+    }
+#endif
+    else {
+        std::cerr << "ERROR: Unknown mode '" << mode << "'\n";
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
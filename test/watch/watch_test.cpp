@@ -0,0 +1,251 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file_io.h"
+
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+static std::string quote(const std::string& text)
+{
+    return "\"" + text + "\"";
+}
+
+static std::string read_text(const std::string& path)
+{
+    std::string contents;
+    read_file(path, contents, std::ios::binary);
+    return contents;
+}
+
+/**
+ * @brief Runs --watch on one input, reading what it reports on stderr.
+ */
+class watch_process
+{
+public:
+    watch_process(const std::string& exe, const std::string& input, const std::string& output)
+    {
+        int fds[2];
+        if (pipe(fds) != 0) return;
+        pid = fork();
+        if (pid == 0)
+        {
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            execl(exe.c_str(), exe.c_str(), "--watch", input.c_str(), output.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        close(fds[1]);
+        report_fd = fds[0];
+    }
+
+    ~watch_process()
+    {
+        if (pid > 0)
+        {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+        if (report_fd >= 0) close(report_fd);
+    }
+
+    /**
+     * @brief Waits for the next line starting with one of 'prefixes', skipping any others.
+     *
+     * @return False if the watcher exits or says nothing of the kind for ten seconds.
+     */
+    bool wait_for(const std::vector<std::string>& prefixes, std::string& line)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (;;)
+        {
+            for (auto end = pending.find('\n'); end != std::string::npos; end = pending.find('\n'))
+            {
+                line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                for (const auto& prefix : prefixes)
+                {
+                    if (line.compare(0, prefix.size(), prefix) == 0) return true;
+                }
+            }
+
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                std::chrono::steady_clock::now()).count();
+            pollfd pfd{ report_fd, POLLIN, 0 };
+            if (left <= 0 || poll(&pfd, 1, static_cast<int>(left)) <= 0) return false;
+
+            char buffer[4096];
+            const ssize_t length = read(report_fd, buffer, sizeof(buffer));
+            if (length <= 0) return false;
+            pending.append(buffer, static_cast<std::size_t>(length));
+        }
+    }
+
+    bool started() const noexcept { return report_fd >= 0; }
+
+private:
+    pid_t pid = -1;
+    int report_fd = -1;
+    std::string pending;
+};
+
+/**
+ * @brief Edits saved at once while the watcher runs, and whether the text they leave should convert.
+ */
+struct save
+{
+    const char* what;
+    std::vector<std::pair<std::string, std::string>> replacements; // Each replaces the first match in the text
+    bool converts;
+};
+
+/**
+ * @brief Saves a series of edits to a file being watched, and checks that after each the output is what converting
+ * the file afresh makes of it, or, if the file no longer converts, that the last good output is kept.
+ */
+static void test_edits(const std::string& exe, const std::string& work_dir)
+{
+    const std::string input = work_dir + "/edited.ts";
+    const std::string output = work_dir + "/edited.h";
+    const std::string fresh = work_dir + "/edited_fresh.h";
+
+    std::string text =
+        "export interface First {\n\ta: number;\n}\n"
+        "export interface Second extends First {\n\tb: string;\n}\n"
+        "export type Mid = \"x\" | \"y\";\n"
+        "export enum Color {\n\tRed,\n\tGreen,\n}\n"
+        "export interface Last {\n\tc: Color;\n\tm: Mid;\n}\n";
+    replace_file(input, text);
+
+    // The edited span of each save is parsed on its own, and ends where the text kept after it starts. A statement the
+    // span cuts short must not be taken as complete, as it would be at the end of a file.
+    const save saves[] = {
+        { "a member of the first declaration changes", { { "a: number", "a: string" } }, true },
+        { "an enum's first line is repeated as an earlier declaration changes",
+            { { "a: string", "a: boolean" }, { "export enum Color {\n", "export enum Color {\nexport enum Color {\n" } },
+            false },
+        { "the repeated line is removed again", { { "export enum Color {\nexport enum Color {\n", "export enum Color {\n" } },
+            true },
+        { "a type argument list is left open above a declaration",
+            { { "export type Mid", "export type Open = Array<\nexport type Mid" } }, false },
+        { "the type argument list is closed", { { "Array<\n", "Array<Mid>;\n" } }, true },
+        { "a declaration is added between two others",
+            { { "export enum Color", "export interface Added {\n\tc: Color;\n}\nexport enum Color" } }, true },
+        { "a declaration that others refer to changes", { { "\"x\" | \"y\"", "\"x\" | \"y\" | \"z\"" } }, true },
+        { "a block comment hides a declaration",
+            { { "export interface Added", "/* export interface Added" }, { "}\nexport enum Color", "} */\nexport enum Color" } },
+            true },
+    };
+
+    watch_process watcher(exe, input, output);
+    std::string line;
+    check(watcher.started() && watcher.wait_for({ "Watching " }, line), "--watch starts");
+
+    std::string last_good = read_text(output);
+    for (const auto& s : saves)
+    {
+        for (const auto& [from, to] : s.replacements)
+        {
+            const auto pos = text.find(from);
+            check(pos != std::string::npos, std::string("the text to edit is found for: ") + s.what);
+            if (pos != std::string::npos) text.replace(pos, from.size(), to);
+        }
+        replace_file(input, text);
+        if (!watcher.wait_for({ "Updated ", "Error encountered " }, line))
+        {
+            check(false, std::string("--watch reports the save after: ") + s.what);
+            return;
+        }
+
+        const std::string command = quote(exe) + " " + quote(input) + " " + quote(fresh) + " 2>" +
+            quote(work_dir + "/edited_fresh.log");
+        const bool fresh_ok = std::system(command.c_str()) == 0;
+        check(fresh_ok == s.converts, std::string("a fresh conversion ") + (s.converts ? "succeeds" : "fails") +
+            " after: " + s.what);
+        if (s.converts)
+        {
+            check(line.rfind("Updated ", 0) == 0, std::string("--watch converts the file after: ") + s.what);
+            last_good = read_text(output);
+            check(last_good == read_text(fresh), std::string("--watch output matches a fresh conversion after: ") + s.what);
+        }
+        else
+        {
+            check(line.rfind("Error encountered ", 0) == 0, std::string("--watch reports a syntax error after: ") + s.what);
+            check(read_text(output) == last_good, std::string("--watch keeps the last good output after: ") + s.what);
+        }
+    }
+}
+
+/**
+ * @brief Edits the files a watched file imports, directly and through another, and checks that each edit converts the
+ * watched file again into what converting it afresh makes of it.
+ */
+static void test_imports(const std::string& exe, const std::string& work_dir)
+{
+    const std::string input = work_dir + "/importer.ts";
+    const std::string output = work_dir + "/importer.h";
+    const std::string fresh = work_dir + "/importer_fresh.h";
+    const std::string middle = work_dir + "/middle.ts";
+    const std::string base = work_dir + "/base.ts";
+
+    replace_file(input, "import { Middle } from \"./middle\";\nexport type Loose = Partial<Middle>;\n");
+    replace_file(middle, "import { Base } from \"./base\";\nexport interface Middle extends Base {\n\tm: number;\n}\n");
+    replace_file(base, "export interface Base {\n\tx: number;\n}\n");
+
+    const std::pair<std::string, std::string> saves[] = {
+        { base, "export interface Base {\n\tx: number;\n\tadded_to_base: string;\n}\n" },
+        { middle, "import { Base } from \"./base\";\nexport interface Middle extends Base {\n\tadded_to_middle: boolean;\n}\n" },
+    };
+
+    watch_process watcher(exe, input, output);
+    std::string line;
+    check(watcher.started() && watcher.wait_for({ "Watching " }, line), "--watch starts on a file with imports");
+
+    for (const auto& [path, text] : saves)
+    {
+        replace_file(path, text);
+        if (!watcher.wait_for({ "Updated ", "Error encountered " }, line) || line.rfind("Updated ", 0) != 0)
+        {
+            check(false, "--watch converts the importing file again after a save to " + path);
+            return;
+        }
+
+        const std::string command = quote(exe) + " " + quote(input) + " " + quote(fresh);
+        check(std::system(command.c_str()) == 0, "a fresh conversion of the importing file succeeds");
+        const std::string converted = read_text(output);
+        check(converted == read_text(fresh), "--watch output matches a fresh conversion after a save to " + path);
+        check(converted.find("added_to_") != std::string::npos, "--watch output has the member added to " + path);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <ts-type-conv> <work_dir>\n";
+        return 1;
+    }
+
+    test_edits(argv[1], argv[2]);
+    test_imports(argv[1], argv[2]);
+    return failures ? 1 : 0;
+}